@@ -0,0 +1,324 @@
+﻿#include "bvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+static const int kSahBins = 12;
+static const uint32_t kMaxLeafSize = 4;
+static const float kTraversalCost = 1.0f;   // 相对于一次图元测试的代价
+static const float kRefitRebuildRatio = 2.0f;
+static const uint32_t kMaxDepth = 48;       // 保证查询用的定长栈（64）不会溢出
+
+static float surfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+// 射线与包围盒的 slab 测试，返回进入距离（未命中返回 FLT_MAX）
+static float rayBoxEntry(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin,
+                         const glm::vec3& boundsMax, float maxT) {
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+    float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxT));
+    return entry <= exit ? entry : FLT_MAX;
+}
+
+
+void Bvh::build(const float* centerX, const float* centerY, const float* centerZ, const float* radius, size_t count) {
+    primX = centerX;
+    primY = centerY;
+    primZ = centerZ;
+    primRadius = radius;
+
+    nodes.clear();
+    primIndices.resize(count);
+    for (size_t i = 0; i < count; i++)
+        primIndices[i] = (uint32_t)i;
+    if (count == 0)
+        return;
+
+    std::vector<glm::vec3> centroid(count), primMin(count), primMax(count);
+    for (size_t i = 0; i < count; i++) {
+        centroid[i] = glm::vec3(centerX[i], centerY[i], centerZ[i]);
+        primMin[i] = centroid[i] - glm::vec3(radius[i]);
+        primMax[i] = centroid[i] + glm::vec3(radius[i]);
+    }
+
+    nodes.reserve(count * 2);
+    BvhNode root;
+    root.left = 0;
+    root.firstPrim = 0;
+    root.primCount = (uint32_t)count;
+    nodes.push_back(root);
+
+    // 自顶向下：子节点总是追加在父节点之后，refit 逆序遍历即为自底向上
+    std::vector<std::pair<uint32_t, uint32_t> > stack(1, std::make_pair(0u, 0u)); // (节点, 深度)
+    while (!stack.empty()) {
+        uint32_t nodeIndex = stack.back().first;
+        uint32_t depth = stack.back().second;
+        stack.pop_back();
+        BvhNode& node = nodes[nodeIndex];
+
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+        for (uint32_t i = node.firstPrim; i < node.firstPrim + node.primCount; i++) {
+            uint32_t prim = primIndices[i];
+            boundsMin = glm::min(boundsMin, primMin[prim]);
+            boundsMax = glm::max(boundsMax, primMax[prim]);
+            centroidMin = glm::min(centroidMin, centroid[prim]);
+            centroidMax = glm::max(centroidMax, centroid[prim]);
+        }
+        node.boundsMin = boundsMin;
+        node.boundsMax = boundsMax;
+        if (node.primCount <= kMaxLeafSize || depth >= kMaxDepth)
+            continue;
+
+        // 分桶 SAH：沿三个轴各把质心范围分成 kSahBins 份，选代价最小的分割面
+        float bestCost = FLT_MAX;
+        int bestAxis = -1, bestSplit = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            if (extent <= 0.0f)
+                continue;
+
+            glm::vec3 binMin[kSahBins], binMax[kSahBins];
+            uint32_t binCount[kSahBins] = {};
+            for (int b = 0; b < kSahBins; b++) {
+                binMin[b] = glm::vec3(FLT_MAX);
+                binMax[b] = glm::vec3(-FLT_MAX);
+            }
+            float binScale = kSahBins / extent;
+            for (uint32_t i = node.firstPrim; i < node.firstPrim + node.primCount; i++) {
+                uint32_t prim = primIndices[i];
+                int b = std::min(kSahBins - 1, (int)((centroid[prim][axis] - centroidMin[axis]) * binScale));
+                binCount[b]++;
+                binMin[b] = glm::min(binMin[b], primMin[prim]);
+                binMax[b] = glm::max(binMax[b], primMax[prim]);
+            }
+
+            // 从右向左累积，得到每个分割面右侧的面积与数量
+            float rightArea[kSahBins];
+            uint32_t rightCount[kSahBins];
+            glm::vec3 accumulatedMin(FLT_MAX), accumulatedMax(-FLT_MAX);
+            uint32_t accumulatedCount = 0;
+            for (int b = kSahBins - 1; b > 0; b--) {
+                accumulatedMin = glm::min(accumulatedMin, binMin[b]);
+                accumulatedMax = glm::max(accumulatedMax, binMax[b]);
+                accumulatedCount += binCount[b];
+                rightArea[b] = surfaceArea(accumulatedMin, accumulatedMax);
+                rightCount[b] = accumulatedCount;
+            }
+
+            accumulatedMin = glm::vec3(FLT_MAX);
+            accumulatedMax = glm::vec3(-FLT_MAX);
+            accumulatedCount = 0;
+            for (int split = 1; split < kSahBins; split++) {
+                accumulatedMin = glm::min(accumulatedMin, binMin[split - 1]);
+                accumulatedMax = glm::max(accumulatedMax, binMax[split - 1]);
+                accumulatedCount += binCount[split - 1];
+                if (accumulatedCount == 0 || rightCount[split] == 0)
+                    continue;
+                float cost = surfaceArea(accumulatedMin, accumulatedMax) * accumulatedCount + rightArea[split] * rightCount[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        // 分割不比直接作为叶子更便宜时停止
+        float leafCost = surfaceArea(boundsMin, boundsMax) * node.primCount;
+        if (bestAxis < 0 || kTraversalCost * surfaceArea(boundsMin, boundsMax) + bestCost >= leafCost)
+            continue;
+
+        float binScale = kSahBins / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+        uint32_t* first = &primIndices[node.firstPrim];
+        uint32_t* middle = std::partition(first, first + node.primCount, [&](uint32_t prim) {
+            int b = std::min(kSahBins - 1, (int)((centroid[prim][bestAxis] - centroidMin[bestAxis]) * binScale));
+            return b < bestSplit;
+        });
+        uint32_t leftCount = (uint32_t)(middle - first);
+
+        BvhNode leftChild, rightChild;
+        leftChild.left = rightChild.left = 0;
+        leftChild.firstPrim = node.firstPrim;
+        leftChild.primCount = leftCount;
+        rightChild.firstPrim = node.firstPrim + leftCount;
+        rightChild.primCount = node.primCount - leftCount;
+
+        uint32_t leftIndex = (uint32_t)nodes.size();
+        node.left = leftIndex; // push_back 之前写入，之后 node 引用可能失效
+        nodes.push_back(leftChild);
+        nodes.push_back(rightChild);
+        stack.push_back(std::make_pair(leftIndex, depth + 1));
+        stack.push_back(std::make_pair(leftIndex + 1, depth + 1));
+    }
+
+    builtCost = treeCost();
+}
+
+float Bvh::treeCost() const {
+    if (nodes.empty())
+        return 0.0f;
+    float rootArea = std::max(surfaceArea(nodes[0].boundsMin, nodes[0].boundsMax), 1e-6f);
+    float cost = 0.0f;
+    for (const BvhNode& node : nodes) {
+        float area = surfaceArea(node.boundsMin, node.boundsMax) / rootArea;
+        cost += node.left ? kTraversalCost * area : area * node.primCount;
+    }
+    return cost;
+}
+
+bool Bvh::refit(const float* centerX, const float* centerY, const float* centerZ, const float* radius) {
+    primX = centerX;
+    primY = centerY;
+    primZ = centerZ;
+    primRadius = radius;
+
+    for (size_t n = nodes.size(); n-- > 0;) {
+        BvhNode& node = nodes[n];
+        if (node.left) {
+            const BvhNode& left = nodes[node.left];
+            const BvhNode& right = nodes[node.left + 1];
+            node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+            node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+            continue;
+        }
+
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+        for (uint32_t i = node.firstPrim; i < node.firstPrim + node.primCount; i++) {
+            uint32_t prim = primIndices[i];
+            glm::vec3 center(centerX[prim], centerY[prim], centerZ[prim]);
+            boundsMin = glm::min(boundsMin, center - glm::vec3(radius[prim]));
+            boundsMax = glm::max(boundsMax, center + glm::vec3(radius[prim]));
+        }
+        node.boundsMin = boundsMin;
+        node.boundsMax = boundsMax;
+    }
+
+    // 对象分散开后节点相互重叠，代价相对构建时明显上升就需要重建
+    return treeCost() <= builtCost * kRefitRebuildRatio;
+}
+
+size_t Bvh::queryFrustum(const Frustum& frustum, uint8_t* visible) const {
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < primIndices.size(); i++)
+        visible[i] = 0;
+    if (nodes.empty())
+        return 0;
+
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes[stack[--top]];
+        FrustumTest test = classifyBox(frustum, node.boundsMin, node.boundsMax);
+        if (test == FRUSTUM_OUTSIDE)
+            continue;
+
+        if (test == FRUSTUM_INSIDE || !node.left) {
+            for (uint32_t i = node.firstPrim; i < node.firstPrim + node.primCount; i++) {
+                uint32_t prim = primIndices[i];
+                if (test == FRUSTUM_INSIDE ||
+                    sphereInFrustum(frustum, glm::vec3(primX[prim], primY[prim], primZ[prim]), primRadius[prim])) {
+                    visible[prim] = 1;
+                    visibleCount++;
+                }
+            }
+            continue;
+        }
+
+        stack[top++] = node.left;
+        stack[top++] = node.left + 1;
+    }
+    return visibleCount;
+}
+
+bool Bvh::rayHitsSphere(uint32_t prim, const glm::vec3& origin, const glm::vec3& direction, float maxT, float& t) const {
+    glm::vec3 offset = origin - glm::vec3(primX[prim], primY[prim], primZ[prim]);
+    float a = glm::dot(direction, direction);
+    float b = glm::dot(offset, direction);
+    float c = glm::dot(offset, offset) - primRadius[prim] * primRadius[prim];
+    float discriminant = b * b - a * c;
+    if (a <= 0.0f || discriminant < 0.0f)
+        return false;
+
+    float root = std::sqrt(discriminant);
+    t = (-b - root) / a;
+    if (t < 0.0f)
+        t = (-b + root) / a; // 起点在球内
+    return t >= 0.0f && t <= maxT;
+}
+
+int Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float& hitT) const {
+    int hit = -1;
+    hitT = FLT_MAX;
+    if (nodes.empty())
+        return hit;
+
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes[stack[--top]];
+        if (rayBoxEntry(origin, inverseDirection, node.boundsMin, node.boundsMax, hitT) == FLT_MAX)
+            continue;
+
+        if (!node.left) {
+            for (uint32_t i = node.firstPrim; i < node.firstPrim + node.primCount; i++) {
+                float t;
+                if (rayHitsSphere(primIndices[i], origin, direction, hitT, t)) {
+                    hitT = t;
+                    hit = (int)primIndices[i];
+                }
+            }
+            continue;
+        }
+
+        // 先访问较近的子节点（后入栈），更早缩短 hitT
+        const BvhNode& left = nodes[node.left];
+        const BvhNode& right = nodes[node.left + 1];
+        float leftEntry = rayBoxEntry(origin, inverseDirection, left.boundsMin, left.boundsMax, hitT);
+        float rightEntry = rayBoxEntry(origin, inverseDirection, right.boundsMin, right.boundsMax, hitT);
+        bool leftFirst = leftEntry <= rightEntry;
+        if ((leftFirst ? rightEntry : leftEntry) != FLT_MAX)
+            stack[top++] = leftFirst ? node.left + 1 : node.left;
+        if ((leftFirst ? leftEntry : rightEntry) != FLT_MAX)
+            stack[top++] = leftFirst ? node.left : node.left + 1;
+    }
+    return hit;
+}
+
+void Bvh::queryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& result) const {
+    result.clear();
+    if (nodes.empty())
+        return;
+
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes[stack[--top]];
+        if (node.boundsMin.x > boundsMax.x || node.boundsMin.y > boundsMax.y || node.boundsMin.z > boundsMax.z ||
+            node.boundsMax.x < boundsMin.x || node.boundsMax.y < boundsMin.y || node.boundsMax.z < boundsMin.z)
+            continue;
+
+        if (!node.left) {
+            for (uint32_t i = node.firstPrim; i < node.firstPrim + node.primCount; i++) {
+                uint32_t prim = primIndices[i];
+                glm::vec3 center(primX[prim], primY[prim], primZ[prim]);
+                glm::vec3 nearest = glm::clamp(center, boundsMin, boundsMax);
+                glm::vec3 offset = center - nearest;
+                if (glm::dot(offset, offset) <= primRadius[prim] * primRadius[prim])
+                    result.push_back(prim);
+            }
+            continue;
+        }
+        stack[top++] = node.left;
+        stack[top++] = node.left + 1;
+    }
+}
@@ -0,0 +1,53 @@
+﻿#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "culling.h"
+
+// BVH 节点：left 为 0 时是叶子（根节点不会是任何节点的子节点），否则左右子节点为 left、left + 1。
+// [firstPrim, firstPrim + primCount) 是整棵子树的图元，在 primIndices 中连续
+struct BvhNode {
+    glm::vec3 boundsMin;
+    uint32_t left;
+    glm::vec3 boundsMax;
+    uint32_t firstPrim;
+    uint32_t primCount;
+};
+
+// 包围球上的层次包围盒：分桶 SAH 构建，对象移动后可只更新包围盒（refit）
+class Bvh {
+public:
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> primIndices; // 叶子引用的图元下标
+
+    // 图元为按结构数组存放的包围球
+    void build(const float* centerX, const float* centerY, const float* centerZ, const float* radius, size_t count);
+
+    // 图元集合不变、只是位置变化时自底向上更新包围盒；树质量明显变差时返回 false，调用者应重建
+    bool refit(const float* centerX, const float* centerY, const float* centerZ, const float* radius);
+
+    size_t primitiveCount() const { return primIndices.size(); }
+
+    // 视锥查询：完全在内侧的子树直接整体接受，相交的叶子再逐个测试包围球。visible 按图元下标写入 0/1，返回可见数
+    size_t queryFrustum(const Frustum& frustum, uint8_t* visible) const;
+
+    // 最近命中的图元（射线与包围球求交），没有命中返回 -1；direction 不必归一化，hitT 以 direction 长度为单位
+    int raycast(const glm::vec3& origin, const glm::vec3& direction, float& hitT) const;
+
+    // 包围盒重叠查询
+    void queryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& result) const;
+
+private:
+    const float* primX = nullptr;  // 最近一次 build/refit 的输入
+    const float* primY = nullptr;
+    const float* primZ = nullptr;
+    const float* primRadius = nullptr;
+    float builtCost = 0.0f;        // 构建完成时的 SAH 代价，refit 后用来判断是否需要重建
+
+    float treeCost() const;
+    bool rayHitsSphere(uint32_t prim, const glm::vec3& origin, const glm::vec3& direction, float maxT, float& t) const;
+};
+
+#endif
@@ -0,0 +1,117 @@
+﻿#include "culling.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_USE_SSE 1
+#else
+#define CULLING_USE_SSE 0
+#endif
+
+
+Frustum extractFrustum(const glm::mat4& viewProjection) {
+    // glm 按列存放：第 i 行为 (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+        row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = row[3] + row[0]; // 左
+    frustum.planes[1] = row[3] - row[0]; // 右
+    frustum.planes[2] = row[3] + row[1]; // 下
+    frustum.planes[3] = row[3] - row[1]; // 上
+    frustum.planes[4] = row[3] + row[2]; // 近
+    frustum.planes[5] = row[3] - row[2]; // 远
+
+    for (int i = 0; i < 6; i++) {
+        float length = glm::length(glm::vec3(frustum.planes[i]));
+        if (length > 0.0f)
+            frustum.planes[i] /= length;
+    }
+    return frustum;
+}
+
+bool sphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius) {
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& plane = frustum.planes[i];
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool boxInFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& plane = frustum.planes[i];
+        // 沿平面法线方向最远的角点仍在外侧时整个盒子在外侧
+        glm::vec3 farthest(plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+                           plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+                           plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+        if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+FrustumTest classifyBox(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    FrustumTest result = FRUSTUM_INSIDE;
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& plane = frustum.planes[i];
+        glm::vec3 normal(plane);
+        glm::vec3 farthest(plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+                           plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+                           plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+        if (glm::dot(normal, farthest) + plane.w < 0.0f)
+            return FRUSTUM_OUTSIDE;
+        // 最近的角点也在内侧时这个平面不切到盒子
+        glm::vec3 nearest(plane.x >= 0.0f ? boundsMin.x : boundsMax.x,
+                          plane.y >= 0.0f ? boundsMin.y : boundsMax.y,
+                          plane.z >= 0.0f ? boundsMin.z : boundsMax.z);
+        if (glm::dot(normal, nearest) + plane.w < 0.0f)
+            result = FRUSTUM_INTERSECT;
+    }
+    return result;
+}
+
+size_t cullSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+                   const float* radius, size_t count, uint8_t* visible) {
+    size_t visibleCount = 0;
+    size_t i = 0;
+#if CULLING_USE_SSE
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(centerX + i);
+        __m128 y = _mm_loadu_ps(centerY + i);
+        __m128 z = _mm_loadu_ps(centerZ + i);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+        // 任一平面上距离 < -radius 即在视锥外
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])),
+                                         _mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+        }
+
+        int outsideMask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++) {
+            uint8_t inside = (outsideMask & (1 << lane)) ? 0 : 1;
+            visible[i + lane] = inside;
+            visibleCount += inside;
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        uint8_t inside = sphereInFrustum(frustum, glm::vec3(centerX[i], centerY[i], centerZ[i]), radius[i]) ? 1 : 0;
+        visible[i] = inside;
+        visibleCount += inside;
+    }
+    return visibleCount;
+}
@@ -0,0 +1,29 @@
+﻿#ifndef _CULLING_H_
+#define _CULLING_H_
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// 视锥体：6 个平面 (a, b, c, d)，法线指向内侧并已归一化，内侧满足 a*x + b*y + c*z + d >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// 从 projection * view 中提取世界空间视锥体（Gribb/Hartmann 方法）
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+// 包围盒相对视锥体的位置：完全在外、与边界相交、完全在内
+enum FrustumTest { FRUSTUM_OUTSIDE, FRUSTUM_INTERSECT, FRUSTUM_INSIDE };
+
+// 包围球 / 包围盒与视锥体是否相交（保守：可能把视锥角附近的物体判为可见）
+bool sphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius);
+bool boxInFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+FrustumTest classifyBox(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+// 批量测试按结构数组存放的包围球，visible[i] 写入 0/1，返回可见数量。
+// SSE 下每次测试 4 个球
+size_t cullSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+                   const float* radius, size_t count, uint8_t* visible);
+
+#endif
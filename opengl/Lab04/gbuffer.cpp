@@ -0,0 +1,64 @@
+﻿#include "gbuffer.h"
+#include <iostream>
+
+GBuffer gBuffer;
+
+void GBuffer::init() {
+    glGenFramebuffers(1, &framebuffer);
+}
+
+static GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+void GBuffer::deleteTargets() {
+    GLuint textures[] = { colorTexture, normalTexture, depthTexture };
+    glDeleteTextures(3, textures);
+    colorTexture = normalTexture = depthTexture = 0;
+}
+
+void GBuffer::createTargets(int width, int height) {
+    deleteTargets();
+    bufferWidth = width;
+    bufferHeight = height;
+
+    // 固有色与色调 RGBA8、法线 RGB10_A2（n * 0.5 + 0.5）、深度 32 位浮点（边缘检测需要精度）
+    colorTexture = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    normalTexture = createTarget(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    depthTexture = createTarget(GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "G-buffer framebuffer is incomplete" << std::endl;
+}
+
+void GBuffer::beginGeometry(int width, int height) {
+    if (width != bufferWidth || height != bufferHeight || !colorTexture)
+        createTargets(width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::release() {
+    deleteTargets();
+    glDeleteFramebuffers(1, &framebuffer);
+    framebuffer = 0;
+    bufferWidth = bufferHeight = 0;
+}
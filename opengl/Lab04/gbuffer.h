@@ -0,0 +1,34 @@
+﻿#ifndef _GBUFFER_H_
+#define _GBUFFER_H_
+
+#include <GL/glew.h>
+
+// 延迟 NPR 管线的 G-buffer：几何通道把固有色、素描色调、法线与深度写入这里，
+// 轮廓由 PostProcess 在屏幕空间检测（开销与屏幕像素数成正比，且能得到正确的剪影边）
+class GBuffer {
+public:
+    void init();
+
+    // 绑定 G-buffer 并清除（尺寸变化时重建附件），之后的几何绘制写入两个颜色附件与深度
+    void beginGeometry(int width, int height);
+
+    GLuint colorTarget() const { return colorTexture; }   // RGBA8：rgb 固有色，a 素描色调
+    GLuint normalTarget() const { return normalTexture; } // RGB10_A2，n * 0.5 + 0.5
+    GLuint depthTarget() const { return depthTexture; }   // 32 位浮点深度
+    int width() const { return bufferWidth; }
+    int height() const { return bufferHeight; }
+
+    void release();
+
+private:
+    GLuint framebuffer = 0;
+    GLuint colorTexture = 0, normalTexture = 0, depthTexture = 0;
+    int bufferWidth = 0, bufferHeight = 0;
+
+    void createTargets(int width, int height);
+    void deleteTargets();
+};
+
+extern GBuffer gBuffer;
+
+#endif
@@ -0,0 +1,137 @@
+﻿#include "gl_state.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+
+GlStateCache glState;
+
+
+bool GlStateCache::filter(bool redundant) {
+    if (redundant)
+        filteredChanges++;
+    else
+        issuedChanges++;
+    return redundant;
+}
+
+void GlStateCache::invalidate() {
+    program = UNKNOWN;
+    vao = UNKNOWN;
+    activeUnit = -1;
+    texturesKnown = false;
+    depthFunc = 0;
+    depthMask = colorMask = blend = -1;
+}
+
+void GlStateCache::invalidateUniforms(GLuint id) {
+    uniforms.erase(id);
+}
+
+void GlStateCache::useProgram(GLuint id) {
+    if (filter(program == id))
+        return;
+    glUseProgram(id);
+    program = id;
+}
+
+void GlStateCache::bindVertexArray(GLuint id) {
+    if (filter(vao == id))
+        return;
+    glBindVertexArray(id);
+    vao = id;
+}
+
+void GlStateCache::bindTexture(GLint unit, GLenum target, GLuint texture) {
+    if (!texturesKnown) {
+        for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+            textures2D[i] = texturesCube[i] = texturesArray[i] = UNKNOWN;
+        texturesKnown = true;
+    }
+    GLuint* bound = nullptr;
+    if (unit < GL_STATE_TEXTURE_UNITS) {
+        if (target == GL_TEXTURE_CUBE_MAP)
+            bound = &texturesCube[unit];
+        else if (target == GL_TEXTURE_2D_ARRAY)
+            bound = &texturesArray[unit];
+        else
+            bound = &textures2D[unit];
+    }
+    if (filter(bound && *bound == texture))
+        return;
+
+    if (activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+    glBindTexture(target, texture);
+    if (bound)
+        *bound = texture;
+}
+
+void GlStateCache::setDepthFunc(GLenum func) {
+    if (filter(depthFunc == func))
+        return;
+    glDepthFunc(func);
+    depthFunc = func;
+}
+
+void GlStateCache::setDepthMask(bool write) {
+    if (filter(depthMask == (int)write))
+        return;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+    depthMask = write;
+}
+
+void GlStateCache::setColorMask(bool write) {
+    if (filter(colorMask == (int)write))
+        return;
+    GLboolean value = write ? GL_TRUE : GL_FALSE;
+    glColorMask(value, value, value, value);
+    colorMask = write;
+}
+
+void GlStateCache::setBlend(bool enabled) {
+    if (filter(blend == (int)enabled))
+        return;
+    if (enabled)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+    blend = enabled;
+}
+
+// uniform 属于程序对象，跨帧保持有效
+void GlStateCache::setUniform1i(const ShaderProgram& target, UniformSlot slot, int value) {
+    if (target[slot] < 0)
+        return;
+    UniformCache& cache = uniforms[target.id];
+    if (filter(cache.intValid[slot] && cache.ints[slot] == value))
+        return;
+    useProgram(target.id);
+    glUniform1i(target[slot], value);
+    cache.ints[slot] = value;
+    cache.intValid[slot] = true;
+}
+
+void GlStateCache::setUniform3f(const ShaderProgram& target, UniformSlot slot, const glm::vec3& value) {
+    if (target[slot] < 0)
+        return;
+    UniformCache& cache = uniforms[target.id];
+    if (filter(cache.vectorValid[slot] && cache.vectors[slot] == value))
+        return;
+    useProgram(target.id);
+    glUniform3f(target[slot], value.x, value.y, value.z);
+    cache.vectors[slot] = value;
+    cache.vectorValid[slot] = true;
+}
+
+void GlStateCache::setUniformMatrix4(const ShaderProgram& target, UniformSlot slot, const glm::mat4& value) {
+    if (target[slot] < 0)
+        return;
+    UniformCache& cache = uniforms[target.id];
+    if (filter(cache.matrixValid[slot] && memcmp(&cache.matrices[slot], &value, sizeof(glm::mat4)) == 0))
+        return;
+    useProgram(target.id);
+    glUniformMatrix4fv(target[slot], 1, GL_FALSE, glm::value_ptr(value));
+    cache.matrices[slot] = value;
+    cache.matrixValid[slot] = true;
+}
@@ -0,0 +1,66 @@
+﻿#ifndef _GL_STATE_H_
+#define _GL_STATE_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <cstddef>
+#include "shader_program.h"
+
+const int GL_STATE_TEXTURE_UNITS = 16;
+
+// 记录当前绑定的 GL 状态，只在值真正改变时调用驱动。
+// 绕过缓存直接修改状态的代码之后需要调用 invalidate（uniform 缓存按程序调用 invalidateUniforms）
+class GlStateCache {
+public:
+    void invalidate();
+    void invalidateUniforms(GLuint program);
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindTexture(GLint unit, GLenum target, GLuint texture); // 支持 GL_TEXTURE_2D、GL_TEXTURE_2D_ARRAY 与 GL_TEXTURE_CUBE_MAP
+
+    void setDepthFunc(GLenum func);
+    void setDepthMask(bool write);
+    void setColorMask(bool write);
+    void setBlend(bool enabled);
+
+    // 会先切换到 program
+    void setUniform1i(const ShaderProgram& program, UniformSlot slot, int value);
+    void setUniform3f(const ShaderProgram& program, UniformSlot slot, const glm::vec3& value);
+    void setUniformMatrix4(const ShaderProgram& program, UniformSlot slot, const glm::mat4& value);
+
+    // 统计：实际发出的状态调用与被过滤掉的冗余调用
+    size_t issuedChanges = 0;
+    size_t filteredChanges = 0;
+    void resetCounters() { issuedChanges = filteredChanges = 0; }
+
+private:
+    static const GLuint UNKNOWN = 0xffffffffu;
+
+    struct UniformCache {
+        int ints[UNIFORM_SLOT_COUNT];
+        bool intValid[UNIFORM_SLOT_COUNT] = {};
+        glm::vec3 vectors[UNIFORM_SLOT_COUNT];
+        bool vectorValid[UNIFORM_SLOT_COUNT] = {};
+        glm::mat4 matrices[UNIFORM_SLOT_COUNT];
+        bool matrixValid[UNIFORM_SLOT_COUNT] = {};
+    };
+
+    GLuint program = UNKNOWN;
+    GLuint vao = UNKNOWN;
+    GLint activeUnit = -1;
+    GLuint textures2D[GL_STATE_TEXTURE_UNITS];
+    GLuint texturesCube[GL_STATE_TEXTURE_UNITS];
+    GLuint texturesArray[GL_STATE_TEXTURE_UNITS];
+    GLenum depthFunc = 0;
+    int depthMask = -1, colorMask = -1, blend = -1;
+    bool texturesKnown = false;
+    std::unordered_map<GLuint, UniformCache> uniforms;
+
+    bool filter(bool redundant);
+};
+
+extern GlStateCache glState;
+
+#endif
@@ -0,0 +1,415 @@
+﻿#include "gpu_driven.h"
+#include "scene.h"
+#include "hiz.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <iostream>
+
+GpuDrivenRenderer gpuDriven;
+
+// 着色器存储缓冲绑定点
+static const GLuint OBJECT_BINDING = 0;
+static const GLuint MESH_INFO_BINDING = 1;
+static const GLuint COMMAND_LIST_BINDING = 2;
+static const GLuint COMMAND_BINDING = 3;
+static const GLuint INSTANCE_INDEX_BINDING = 4;
+
+static const GLuint CULL_GROUP_SIZE = 64;
+
+// 与着色器中 ObjectData (std430) 一致
+struct GpuObject {
+    glm::mat4 model;
+    glm::vec4 sphere;   // 世界空间球心 + 半径
+    uint32_t mesh;
+    uint32_t padding[3];
+};
+
+// 与着色器中 MeshInfo 一致
+struct GpuMeshInfo {
+    uint32_t firstCommand;  // commandList 中的起点
+    uint32_t commandCount;
+    uint32_t instanceStart; // 该网格的实例下标区间起点（即各命令的 baseInstance）
+    uint32_t visibleCount;  // 计算着色器中原子递增
+};
+
+static const char* cullShaderSource = R"(
+#version 430 core
+layout(local_size_x = 64) in;
+
+struct ObjectData { mat4 model; vec4 sphere; uvec4 mesh; };
+struct MeshInfo { uint firstCommand; uint commandCount; uint instanceStart; uint visibleCount; };
+struct DrawCommand { uint count; uint instanceCount; uint firstIndex; int baseVertex; uint baseInstance; };
+
+layout(std430, binding = 0) readonly buffer Objects { ObjectData objects[]; };
+layout(std430, binding = 1) buffer MeshInfos { MeshInfo meshInfos[]; };
+layout(std430, binding = 2) readonly buffer CommandLists { uint commandList[]; };
+layout(std430, binding = 3) buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 4) writeonly buffer InstanceIndices { uint instanceIndices[]; };
+
+uniform vec4 frustumPlanes[6];
+uniform uint objectCount;
+
+uniform bool hiZEnabled;
+uniform sampler2D hiZ;
+uniform ivec2 hiZSize;
+uniform int hiZLevels;
+
+// 包围球外接盒投影到屏幕，在使其最多覆盖 2x2 纹素的级别上取最大深度，比球的最近深度还近则被挡住
+bool occluded(vec4 sphere) {
+    mat4 viewProjection = projection * view;
+    vec3 ndcMin = vec3(1e30), ndcMax = vec3(-1e30);
+    for (int i = 0; i < 8; i++) {
+        vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        if (clip.w <= 1e-4)
+            return false; // 跨过相机平面
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+
+    vec2 pixelMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0) * vec2(hiZSize);
+    vec2 pixelMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0) * vec2(hiZSize);
+    vec2 extent = pixelMax - pixelMin;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);
+
+    ivec2 levelSize = max(hiZSize >> level, ivec2(1));
+    ivec2 t0 = min(ivec2(pixelMin) >> level, levelSize - 1);
+    ivec2 t1 = min(ivec2(pixelMax) >> level, levelSize - 1);
+    float maxDepth = max(max(texelFetch(hiZ, t0, level).r, texelFetch(hiZ, ivec2(t1.x, t0.y), level).r),
+                         max(texelFetch(hiZ, ivec2(t0.x, t1.y), level).r, texelFetch(hiZ, t1, level).r));
+    return ndcMin.z * 0.5 + 0.5 > maxDepth;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= objectCount)
+        return;
+
+    vec4 sphere = objects[index].sphere;
+    for (int i = 0; i < 6; i++) {
+        if (dot(frustumPlanes[i].xyz, sphere.xyz) + frustumPlanes[i].w < -sphere.w)
+            return;
+    }
+    if (hiZEnabled && occluded(sphere))
+        return;
+
+    uint mesh = objects[index].mesh.x;
+    uint slot = atomicAdd(meshInfos[mesh].visibleCount, 1u);
+    instanceIndices[meshInfos[mesh].instanceStart + slot] = index;
+
+    // 同一网格的各材质命令共用实例区间，取最大值即为该网格的可见数
+    uint first = meshInfos[mesh].firstCommand;
+    for (uint c = 0u; c < meshInfos[mesh].commandCount; c++)
+        atomicMax(commands[commandList[first + c]].instanceCount, slot + 1u);
+}
+)";
+
+static const char* drawVertexShaderSource = R"(
+#version 430 core
+layout(location = 0) in vec3 vertex_position;
+layout(location = 1) in vec3 vertex_normal;
+layout(location = 2) in vec2 vertex_texcoord;
+layout(location = 7) in uint instance_index; // 从 baseInstance 开始逐实例读取
+
+struct ObjectData { mat4 model; vec4 sphere; uvec4 mesh; };
+layout(std430, binding = 0) readonly buffer Objects { ObjectData objects[]; };
+
+out vec3 fragPosition;
+out vec3 fragNormal;
+out vec2 fragTexcoord;
+invariant gl_Position;
+
+void main() {
+    mat4 modelMatrix = objects[instance_index].model;
+    fragPosition = vec3(modelMatrix * vec4(vertex_position, 1.0));
+    fragNormal = mat3(transpose(inverse(modelMatrix))) * vertex_normal;
+    fragTexcoord = vertex_texcoord;
+    gl_Position = projection * view * vec4(fragPosition, 1.0);
+}
+)";
+
+// 深度预渲染与着色通道共用同一个顶点着色器，保证 GL_EQUAL 深度测试逐位一致
+static const char* depthFragmentShaderSource = R"(
+#version 330 core
+void main() {
+}
+)";
+
+
+bool GpuDrivenRenderer::init(const char* fragmentSource) {
+    available = false;
+    if (!GLEW_VERSION_4_3) {
+        std::cout << "OpenGL 4.3 not available, using CPU culling" << std::endl;
+        return false;
+    }
+
+    if (!linkComputeProgram(cullProgram, cullShaderSource) ||
+        !linkProgram(drawProgram, drawVertexShaderSource, fragmentSource) ||
+        !linkProgram(depthProgram, drawVertexShaderSource, depthFragmentShaderSource)) {
+        std::cerr << "GPU-driven shaders failed, using CPU culling" << std::endl;
+        return false;
+    }
+
+    glGenBuffers(1, &objectBuffer);
+    glGenBuffers(1, &meshInfoBuffer);
+    glGenBuffers(1, &commandListBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &instanceIndexBuffer);
+    available = true;
+    return true;
+}
+
+void GpuDrivenRenderer::buildPool(const Scene& scene) {
+    commands.clear();
+    commandMesh.clear();
+    groups.clear();
+
+    // 统计池的大小：只收录三角形列表网格（条带与重启标记无法和其他网格共用一次间接绘制）
+    GLsizei vertexStride = meshVertexFormat == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+    size_t totalVertices = 0, totalIndices = 0;
+    meshPooled.assign(scene.meshes.size(), 0);
+    unpooledMeshes = 0;
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        const ModelData& mesh = scene.meshes[m];
+        if (!mesh.vao || mesh.primitive != GL_TRIANGLES) {
+            unpooledMeshes++;
+            continue;
+        }
+        meshPooled[m] = 1;
+        totalVertices += mesh.pointCount;
+        totalIndices += mesh.indexCount ? mesh.indexCount : mesh.pointCount;
+    }
+
+    if (!poolVAO) {
+        glGenVertexArrays(1, &poolVAO);
+        glGenBuffers(1, &poolVBO);
+        glGenBuffers(1, &poolEBO);
+    }
+    glBindVertexArray(poolVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, poolVBO);
+    glBufferData(GL_ARRAY_BUFFER, totalVertices * vertexStride, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, poolEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalIndices * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+
+    // 顶点直接在 GPU 上从各网格的 VBO 拷贝；索引统一为 32 位，保留网格内的相对下标，靠 baseVertex 偏移
+    struct PendingCommand {
+        DrawElementsIndirectCommand command;
+        uint32_t mesh;
+        GLuint textureID, normalMapTexture;
+    };
+    std::vector<PendingCommand> pending;
+    size_t vertexCursor = 0, indexCursor = 0;
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        const ModelData& mesh = scene.meshes[m];
+        if (!meshPooled[m])
+            continue;
+
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh.vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, vertexCursor * vertexStride, mesh.pointCount * vertexStride);
+
+        std::vector<uint32_t> indices;
+        if (mesh.indexCount)
+            indices.assign(mesh.indexData(), mesh.indexData() + mesh.indexCount);
+        else
+            for (uint32_t i = 0; i < (uint32_t)mesh.pointCount; i++)
+                indices.push_back(i);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexCursor * sizeof(uint32_t), indices.size() * sizeof(uint32_t), indices.data());
+
+        PendingCommand command = {};
+        command.command.baseVertex = (GLint)vertexCursor;
+        command.mesh = (uint32_t)m;
+        if (mesh.batches.empty()) {
+            command.command.count = (GLuint)indices.size();
+            command.command.firstIndex = (GLuint)indexCursor;
+            command.textureID = mesh.textureID;
+            command.normalMapTexture = mesh.normalMapTexture;
+            pending.push_back(command);
+        }
+        for (const MeshBatch& batch : mesh.batches) {
+            command.command.count = batch.indexCount;
+            command.command.firstIndex = (GLuint)indexCursor + batch.firstIndex;
+            command.textureID = batch.textureID;
+            command.normalMapTexture = batch.normalMapTexture;
+            pending.push_back(command);
+        }
+
+        vertexCursor += mesh.pointCount;
+        indexCursor += indices.size();
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    setupVertexAttributes(meshVertexFormat);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceIndexBuffer);
+    glVertexAttribIPointer(INSTANCE_INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+    glVertexAttribDivisor(INSTANCE_INDEX_LOCATION, 1);
+    glEnableVertexAttribArray(INSTANCE_INDEX_LOCATION);
+    glBindVertexArray(0);
+
+    // 按贴图排序，相同材质的命令连续，每组一次间接绘制
+    std::stable_sort(pending.begin(), pending.end(), [](const PendingCommand& a, const PendingCommand& b) {
+        return a.textureID != b.textureID ? a.textureID < b.textureID : a.normalMapTexture < b.normalMapTexture;
+    });
+    for (size_t c = 0; c < pending.size(); c++) {
+        const PendingCommand& command = pending[c];
+        if (groups.empty() || groups.back().textureID != command.textureID ||
+            groups.back().normalMapTexture != command.normalMapTexture) {
+            MaterialGroup group;
+            group.textureID = command.textureID;
+            group.normalMapTexture = command.normalMapTexture;
+            group.firstCommand = (uint32_t)c;
+            groups.push_back(group);
+        }
+        groups.back().commandCount++;
+        commands.push_back(command.command);
+        commandMesh.push_back(command.mesh);
+    }
+
+    // 每个网格的命令下标列表（计数排序）
+    meshCommandStart.assign(scene.meshes.size() + 1, 0);
+    for (uint32_t mesh : commandMesh)
+        meshCommandStart[mesh + 1]++;
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+        meshCommandStart[m + 1] += meshCommandStart[m];
+    commandList.resize(commandMesh.size());
+    std::vector<uint32_t> cursor(meshCommandStart.begin(), meshCommandStart.end() - 1);
+    for (size_t c = 0; c < commandMesh.size(); c++)
+        commandList[cursor[commandMesh[c]]++] = (uint32_t)c;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandListBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(commandList.size(), 1) * sizeof(uint32_t), commandList.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    pooledMeshes = scene.meshes.size();
+    if (unpooledMeshes)
+        std::cout << "GPU-driven pool: " << unpooledMeshes << " non-triangle-list mesh(es) fall back to CPU culling" << std::endl;
+}
+
+void GpuDrivenRenderer::cull(const Scene& scene, const Frustum& frustum, const HiZBuffer* occlusion) {
+    hasCommands = false;
+    if (!available)
+        return;
+    if (pooledMeshes != scene.meshes.size())
+        buildPool(scene);
+
+    size_t objectCount = scene.objectCount();
+    if (objectCount == 0 || commands.empty())
+        return;
+
+    // 实例区间：按网格统计对象数并做前缀和，每条命令的 baseInstance 指向所属网格的区间
+    std::vector<GpuMeshInfo> meshInfos(scene.meshes.size());
+    std::vector<uint32_t> meshObjects(scene.meshes.size(), 0);
+    for (size_t i = 0; i < objectCount; i++)
+        meshObjects[scene.meshIds[i]]++;
+    uint32_t instanceStart = 0;
+    for (size_t m = 0; m < meshInfos.size(); m++) {
+        meshInfos[m].firstCommand = meshCommandStart[m];
+        meshInfos[m].commandCount = meshCommandStart[m + 1] - meshCommandStart[m];
+        meshInfos[m].instanceStart = instanceStart;
+        meshInfos[m].visibleCount = 0;
+        instanceStart += meshObjects[m];
+    }
+    for (size_t c = 0; c < commands.size(); c++) {
+        commands[c].instanceCount = 0;
+        commands[c].baseInstance = meshInfos[commandMesh[c]].instanceStart;
+    }
+
+    std::vector<GpuObject> objects(objectCount);
+    for (size_t i = 0; i < objectCount; i++) {
+        objects[i].model = scene.modelMatrices[i];
+        objects[i].sphere = glm::vec4(scene.sphereX[i], scene.sphereY[i], scene.sphereZ[i], scene.sphereRadius[i]);
+        objects[i].mesh = scene.meshIds[i];
+    }
+
+    // 每帧整体重新分配（orphan），不必等待上一帧的绘制读完
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, objects.size() * sizeof(GpuObject), objects.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshInfoBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshInfos.size() * sizeof(GpuMeshInfo), meshInfos.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+    if (objectCount > objectCapacity) {
+        objectCapacity = std::max(objectCount, objectCapacity * 2);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceIndexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, objectCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_INFO_BINDING, meshInfoBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_LIST_BINDING, commandListBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_INDEX_BINDING, instanceIndexBuffer);
+
+    // 每个线程一个对象
+    glUseProgram(cullProgram.id);
+    glUniform4fv(cullProgram[U_FRUSTUM_PLANES], 6, glm::value_ptr(frustum.planes[0]));
+    glUniform1ui(cullProgram[U_OBJECT_COUNT], (GLuint)objectCount);
+    bool testOcclusion = occlusion && occlusion->isReady();
+    glUniform1i(cullProgram[U_HIZ_ENABLED], testOcclusion);
+    if (testOcclusion) {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_HIZ);
+        glBindTexture(GL_TEXTURE_2D, occlusion->texture());
+        glUniform2i(cullProgram[U_HIZ_SIZE], occlusion->width(), occlusion->height());
+        glUniform1i(cullProgram[U_HIZ_LEVELS], occlusion->levelCount());
+    }
+    glDispatchCompute((GLuint)((objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    if (testOcclusion) {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_HIZ);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    hasCommands = true;
+}
+
+void GpuDrivenRenderer::drawDepth() {
+    if (!hasCommands)
+        return;
+
+    glUseProgram(depthProgram.id);
+    glBindVertexArray(poolVAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)commands.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void GpuDrivenRenderer::draw(bool bindNormalMaps) {
+    if (!hasCommands)
+        return;
+
+    // 每个材质组一次间接绘制
+    glUseProgram(drawProgram.id);
+    glUniform1i(drawProgram[U_BUMP_MAPPING], bindNormalMaps);
+    glUniform3f(drawProgram[U_DEFAULT_COLOR], 0.8f, 0.8f, 0.8f);
+    glBindVertexArray(poolVAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    for (const MaterialGroup& group : groups) {
+        glUniform1i(drawProgram[U_USE_TEXTURE], group.textureID ? 1 : 0);
+        if (group.textureID) {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_DIFFUSE);
+            glBindTexture(GL_TEXTURE_2D, group.textureID);
+        }
+        if (bindNormalMaps && group.normalMapTexture) {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_NORMAL_MAP);
+            glBindTexture(GL_TEXTURE_2D, group.normalMapTexture);
+        }
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+            (void*)(group.firstCommand * sizeof(DrawElementsIndirectCommand)), (GLsizei)group.commandCount, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void GpuDrivenRenderer::release() {
+    glDeleteVertexArrays(1, &poolVAO);
+    GLuint buffers[] = { poolVBO, poolEBO, objectBuffer, meshInfoBuffer, commandListBuffer, commandBuffer, instanceIndexBuffer };
+    glDeleteBuffers(7, buffers);
+    glDeleteProgram(cullProgram.id);
+    glDeleteProgram(drawProgram.id);
+    glDeleteProgram(depthProgram.id);
+    poolVAO = poolVBO = poolEBO = 0;
+    objectBuffer = meshInfoBuffer = commandListBuffer = commandBuffer = instanceIndexBuffer = 0;
+    objectCapacity = pooledMeshes = 0;
+    available = hasCommands = false;
+}
@@ -0,0 +1,81 @@
+﻿#ifndef _GPU_DRIVEN_H_
+#define _GPU_DRIVEN_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "shader_program.h"
+#include "culling.h"
+
+class Scene;
+class HiZBuffer;
+
+// 与 glMultiDrawElementsIndirect 读取的结构一致
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// 实例顶点属性：baseInstance 偏移后读到对象下标，再到对象缓冲中取模型矩阵
+const GLuint INSTANCE_INDEX_LOCATION = 7;
+
+// GPU 驱动渲染（需要 GL 4.3）：场景网格合并进一个顶点/索引池，计算着色器对每个对象做视锥与遮挡剔除，
+// 直接写出间接绘制命令，CPU 端每个材质只提交一次 glMultiDrawElementsIndirect。
+// 不支持计算着色器时 init 返回 false，调用者继续使用 CPU 剔除 + 实例化绘制
+class GpuDrivenRenderer {
+public:
+    // fragmentSource 与 CPU 路径共用，保证两条路径画面一致
+    bool init(const char* fragmentSource);
+    bool isAvailable() const { return available; }
+
+    // 在 GPU 上剔除场景中的全部对象并生成本帧的绘制命令（调用前需先 updateTransforms）。
+    // 网格库有新增时重建网格池；occlusion 非空时再用本帧的层次 Z 金字塔做遮挡剔除
+    void cull(const Scene& scene, const Frustum& frustum, const HiZBuffer* occlusion = nullptr);
+
+    // 用 cull 生成的命令绘制：着色通道每个材质组一次间接绘制，深度预渲染不分材质只提交一次
+    void draw(bool bindNormalMaps);
+    void drawDepth();
+    GLuint drawProgramId() const { return drawProgram.id; } // draw 直接写这个程序的 uniform
+
+    // 条带等无法进池的网格（GPU 剔除不为其生成命令），这些对象仍由调用者走 CPU 剔除与实例化绘制
+    bool isPooled(uint32_t mesh) const { return mesh < meshPooled.size() && meshPooled[mesh]; }
+    bool hasUnpooledMeshes() const { return unpooledMeshes > 0; }
+
+    void release();
+
+private:
+    // 一组共用贴图的命令在命令缓冲中连续存放，一次间接绘制提交
+    struct MaterialGroup {
+        GLuint textureID = 0;
+        GLuint normalMapTexture = 0;
+        uint32_t firstCommand = 0;
+        uint32_t commandCount = 0;
+    };
+
+    bool available = false;
+    ShaderProgram cullProgram, drawProgram, depthProgram;
+    bool hasCommands = false;
+
+    GLuint poolVAO = 0, poolVBO = 0, poolEBO = 0;
+    GLuint objectBuffer = 0, meshInfoBuffer = 0, commandListBuffer = 0, commandBuffer = 0, instanceIndexBuffer = 0;
+    size_t objectCapacity = 0;
+    size_t pooledMeshes = 0;
+    std::vector<char> meshPooled;
+    size_t unpooledMeshes = 0;
+
+    std::vector<DrawElementsIndirectCommand> commands; // 命令模板（instanceCount 每帧清零）
+    std::vector<uint32_t> commandMesh;                 // 每条命令所属网格
+    std::vector<uint32_t> meshCommandStart;            // 网格 m 的命令下标位于 commandList[meshCommandStart[m], meshCommandStart[m + 1])
+    std::vector<uint32_t> commandList;
+    std::vector<MaterialGroup> groups;
+
+    void buildPool(const Scene& scene);
+};
+
+extern GpuDrivenRenderer gpuDriven;
+
+#endif
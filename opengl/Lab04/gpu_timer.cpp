@@ -0,0 +1,79 @@
+﻿#include "gpu_timer.h"
+
+bool GpuTimer::init(int sectionCount) {
+    // 计时查询自 GL 3.3 起为核心功能
+    available = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (!available)
+        return false;
+
+    sections = sectionCount;
+    queries.resize((size_t)FRAMES * sections);
+    glGenQueries((GLsizei)queries.size(), queries.data());
+    pending.assign(queries.size(), false);
+    reset();
+    return true;
+}
+
+void GpuTimer::collect(int index, int section) {
+    if (!pending[index])
+        return;
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+    pending[index] = false;
+    totalNanoseconds[section] += (double)elapsed;
+    samples[section]++;
+}
+
+void GpuTimer::begin(int section) {
+    if (!available)
+        return;
+    // FRAMES 帧之前的结果此时通常早已可用
+    int index = frameSlot * sections + section;
+    collect(index, section);
+    glBeginQuery(GL_TIME_ELAPSED, queries[index]);
+    pending[index] = true;
+}
+
+void GpuTimer::end() {
+    if (available)
+        glEndQuery(GL_TIME_ELAPSED);
+}
+
+void GpuTimer::endFrame() {
+    frameSlot = (frameSlot + 1) % FRAMES;
+}
+
+void GpuTimer::flush() {
+    if (!available)
+        return;
+    for (int slot = 0; slot < FRAMES; slot++)
+        for (int section = 0; section < sections; section++)
+            collect(slot * sections + section, section);
+}
+
+double GpuTimer::averageMilliseconds(int section) const {
+    if (!available || samples[section] == 0)
+        return 0.0;
+    return totalNanoseconds[section] / samples[section] * 1e-6;
+}
+
+void GpuTimer::reset() {
+    // 丢弃还在路上的结果，避免把切换前的耗时算进来
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i]) {
+            GLuint64 elapsed;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+            pending[i] = false;
+        }
+    }
+    totalNanoseconds.assign(sections, 0.0);
+    samples.assign(sections, 0);
+}
+
+void GpuTimer::release() {
+    if (!queries.empty())
+        glDeleteQueries((GLsizei)queries.size(), queries.data());
+    queries.clear();
+    pending.clear();
+    available = false;
+}
@@ -0,0 +1,41 @@
+﻿#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include <GL/glew.h>
+#include <vector>
+
+// 按区段统计 GPU 耗时（GL_TIME_ELAPSED）。每个区段有 FRAMES 个查询轮流使用，
+// 结果在几帧之后再取，不让 CPU 等待 GPU
+class GpuTimer {
+public:
+    bool init(int sectionCount);
+    bool isAvailable() const { return available; }
+
+    // 区段之间不能嵌套
+    void begin(int section);
+    void end();
+    void endFrame();
+
+    // 取回所有未完成的查询（会等待 GPU），之后 averageMilliseconds 包含全部帧
+    void flush();
+    double averageMilliseconds(int section) const;
+    int sampleCount(int section) const { return available ? samples[section] : 0; }
+    void reset();
+
+    void release();
+
+private:
+    static const int FRAMES = 3;
+
+    bool available = false;
+    int sections = 0;
+    int frameSlot = 0;
+    std::vector<GLuint> queries;      // [slot * sections + section]
+    std::vector<bool> pending;
+    std::vector<double> totalNanoseconds;
+    std::vector<int> samples;
+
+    void collect(int index, int section);
+};
+
+#endif
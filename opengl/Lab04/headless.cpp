@@ -0,0 +1,209 @@
+﻿#include "headless.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <sys/stat.h>
+#elif defined(_WIN32)
+#include <direct.h>
+#endif
+
+#if defined(__linux__)
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLContext eglContext = EGL_NO_CONTEXT;
+static EGLSurface eglSurface = EGL_NO_SURFACE;
+#endif
+
+static GLuint offscreenFBO = 0, offscreenColorRBO = 0, offscreenDepthRBO = 0;
+
+
+bool parseHeadlessArgs(int argc, char** argv, HeadlessOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--headless" && hasValue) {
+            options.enabled = true;
+            options.frameCount = atoi(argv[++i]);
+        }
+        else if (arg == "--out" && hasValue) {
+            options.outputDir = argv[++i];
+        }
+        else if (arg == "--start" && hasValue) {
+            options.firstFrame = atoi(argv[++i]);
+        }
+        else if (arg == "--path-length" && hasValue) {
+            options.pathLength = atoi(argv[++i]);
+        }
+        else if (arg == "--size" && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) {
+                std::cerr << "Invalid --size, expected WxH: " << argv[i] << std::endl;
+                return false;
+            }
+        }
+    }
+
+    if (!options.enabled)
+        return true;
+
+    if (options.frameCount <= 0 || options.width <= 0 || options.height <= 0) {
+        std::cerr << "Invalid headless options" << std::endl;
+        return false;
+    }
+    if (options.pathLength <= 0)
+        options.pathLength = options.firstFrame + options.frameCount;
+
+    // 确保输出目录存在
+#if defined(__linux__)
+    mkdir(options.outputDir.c_str(), 0755);
+#elif defined(_WIN32)
+    _mkdir(options.outputDir.c_str());
+#endif
+    return true;
+}
+
+
+#if defined(__linux__)
+bool createHeadlessContext() {
+    // 优先使用 Mesa 的 surfaceless 平台：不需要 X11/Wayland，也不需要 GPU（llvmpipe）
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (eglDisplay == EGL_NO_DISPLAY)
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+        std::cerr << "EGL initialization failed" << std::endl;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL does not support desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    EGLint numConfigs = 0;
+    eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs);
+
+    // 与 freeglut 窗口一致，使用默认（兼容）上下文
+    eglContext = eglCreateContext(eglDisplay, numConfigs > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, nullptr);
+    if (eglContext == EGL_NO_CONTEXT) {
+        std::cerr << "EGL context creation failed: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+
+    // 所有渲染都进 FBO，因此不需要真正的表面；不支持 surfaceless 时退回 1x1 pbuffer
+    const char* extensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+    bool surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+    if (!surfaceless && numConfigs > 0) {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        eglSurface = eglCreatePbufferSurface(eglDisplay, config, pbufferAttribs);
+    }
+
+    if (!eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+        std::cerr << "EGL make current failed: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+        return false;
+    }
+
+    // glew 需要在上下文创建之后初始化；无 GLX 时 glxew 部分的返回值可以忽略
+    glewExperimental = GL_TRUE;
+    glewInit();
+    glGetError();
+
+    if (!GLEW_VERSION_3_3) {
+        std::cerr << "OpenGL 3.3 is required, got: " << glGetString(GL_VERSION) << std::endl;
+        return false;
+    }
+
+    std::cout << "Headless EGL " << major << "." << minor << ", renderer: " << glGetString(GL_RENDERER)
+              << ", version: " << glGetString(GL_VERSION) << std::endl;
+    return true;
+}
+
+void destroyHeadlessContext() {
+    if (eglDisplay == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (eglSurface != EGL_NO_SURFACE)
+        eglDestroySurface(eglDisplay, eglSurface);
+    if (eglContext != EGL_NO_CONTEXT)
+        eglDestroyContext(eglDisplay, eglContext);
+    eglTerminate(eglDisplay);
+    eglDisplay = EGL_NO_DISPLAY;
+    eglContext = EGL_NO_CONTEXT;
+    eglSurface = EGL_NO_SURFACE;
+}
+#else
+bool createHeadlessContext() {
+    std::cerr << "Headless mode is only supported on Linux (EGL)" << std::endl;
+    return false;
+}
+
+void destroyHeadlessContext() {
+}
+#endif
+
+
+GLuint createOffscreenTarget(int width, int height) {
+    glGenFramebuffers(1, &offscreenFBO);
+    glGenRenderbuffers(1, &offscreenColorRBO);
+    glGenRenderbuffers(1, &offscreenDepthRBO);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenColorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreenFBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreenDepthRBO);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+    }
+
+    return offscreenFBO;
+}
+
+void destroyOffscreenTarget() {
+    glDeleteFramebuffers(1, &offscreenFBO);
+    glDeleteRenderbuffers(1, &offscreenColorRBO);
+    glDeleteRenderbuffers(1, &offscreenDepthRBO);
+    offscreenFBO = offscreenColorRBO = offscreenDepthRBO = 0;
+}
+
+
+bool writeFramePPM(const std::string& path, int width, int height) {
+    std::vector<unsigned char> pixels(width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to write frame: " << path << std::endl;
+        return false;
+    }
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    // OpenGL 的原点在左下角，写出时逐行翻转
+    for (int y = height - 1; y >= 0; y--)
+        file.write((const char*)&pixels[y * width * 3], width * 3);
+
+    return true;
+}
@@ -0,0 +1,32 @@
+﻿#ifndef _HEADLESS_H_
+#define _HEADLESS_H_
+
+#include <GL/glew.h>
+#include <string>
+
+// 无窗口（离屏）批量渲染参数
+struct HeadlessOptions {
+    bool enabled = false;           // 是否启用无窗口模式
+    int frameCount = 0;             // 本次渲染的帧数
+    int firstFrame = 0;             // 起始帧号（用于多个进程分段渲染同一条相机路径）
+    int pathLength = 0;             // 相机路径总帧数（0 表示等于 frameCount）
+    int width = 800;                // 输出分辨率
+    int height = 600;
+    std::string outputDir = "frames"; // 输出目录
+};
+
+// 解析命令行：--headless N [--out DIR] [--start K] [--path-length M] [--size WxH]
+bool parseHeadlessArgs(int argc, char** argv, HeadlessOptions& options);
+
+// 创建不依赖显示器的 OpenGL 上下文（Linux 下使用 EGL surfaceless，可运行在 Mesa llvmpipe 上）
+bool createHeadlessContext();
+void destroyHeadlessContext();
+
+// 创建离屏渲染目标（颜色 + 深度），返回 FBO
+GLuint createOffscreenTarget(int width, int height);
+void destroyOffscreenTarget();
+
+// 读取当前绑定帧缓冲的颜色并写成 PPM 文件
+bool writeFramePPM(const std::string& path, int width, int height);
+
+#endif
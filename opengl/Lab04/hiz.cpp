@@ -0,0 +1,307 @@
+﻿#include "hiz.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+
+HiZBuffer hiZBuffer;
+
+// CPU 回读的那一级宽度不超过此值（800x600 时为第 3 级 100x75）
+static const int kReadbackMaxWidth = 128;
+
+static const char* occluderVertexShader = R"(
+#version 330 core
+layout(location = 0) in vec3 vertex_position;
+
+uniform mat4 model;
+
+void main() {
+    gl_Position = projection * view * model * vec4(vertex_position, 1.0);
+}
+)";
+
+static const char* occluderFragmentShader = R"(
+#version 330 core
+void main() {
+}
+)";
+
+// 全屏三角形，无需顶点缓冲
+static const char* reduceVertexShader = R"(
+#version 330 core
+void main() {
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// 上一级的 BASE/MAX_LEVEL 被限制为同一级，texelFetch 的 0 级即上一级
+static const char* reduceFragmentShader = R"(
+#version 330 core
+uniform sampler2D hiZ;
+uniform ivec2 previousSize;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = previousSize - 1;
+    // 上一级边长为奇数时，最后一列/行的输出需要多覆盖一个纹素
+    int spanX = ((previousSize.x & 1) != 0 && coord.x + 2 == last.x) ? 2 : 1;
+    int spanY = ((previousSize.y & 1) != 0 && coord.y + 2 == last.y) ? 2 : 1;
+
+    float depth = 0.0;
+    for (int y = 0; y <= spanY; y++)
+        for (int x = 0; x <= spanX; x++)
+            depth = max(depth, texelFetch(hiZ, min(coord + ivec2(x, y), last), 0).r);
+    gl_FragDepth = depth;
+}
+)";
+
+
+void buildDepthPyramid(DepthPyramid& pyramid) {
+    pyramid.widths.resize(1);
+    pyramid.heights.resize(1);
+    pyramid.levels.resize(1);
+
+    while (pyramid.widths.back() > 1 || pyramid.heights.back() > 1) {
+        int previousWidth = pyramid.widths.back(), previousHeight = pyramid.heights.back();
+        int width = std::max(1, previousWidth / 2), height = std::max(1, previousHeight / 2);
+        std::vector<float> level((size_t)width * height);
+        const std::vector<float>& previous = pyramid.levels.back();
+
+        for (int y = 0; y < height; y++) {
+            int y0 = y * 2;
+            int y1 = std::min((previousHeight & 1) && y == height - 1 ? y0 + 2 : y0 + 1, previousHeight - 1);
+            for (int x = 0; x < width; x++) {
+                int x0 = x * 2;
+                int x1 = std::min((previousWidth & 1) && x == width - 1 ? x0 + 2 : x0 + 1, previousWidth - 1);
+                float depth = 0.0f;
+                for (int sy = y0; sy <= y1; sy++)
+                    for (int sx = x0; sx <= x1; sx++)
+                        depth = std::max(depth, previous[(size_t)sy * previousWidth + sx]);
+                level[(size_t)y * width + x] = depth;
+            }
+        }
+
+        pyramid.widths.push_back(width);
+        pyramid.heights.push_back(height);
+        pyramid.levels.push_back(std::move(level));
+    }
+}
+
+bool sphereOccluded(const DepthPyramid& pyramid, const glm::vec3& center, float radius) {
+    if (pyramid.empty())
+        return false;
+
+    // 包围球外接盒的 8 个角投影到屏幕，取屏幕矩形与最近深度
+    glm::vec3 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner = center + radius * glm::vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+        glm::vec4 clip = pyramid.viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 1e-4f)
+            return false; // 跨过相机平面
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+
+    float pixelMinX = glm::clamp(ndcMin.x * 0.5f + 0.5f, 0.0f, 1.0f) * pyramid.baseWidth;
+    float pixelMaxX = glm::clamp(ndcMax.x * 0.5f + 0.5f, 0.0f, 1.0f) * pyramid.baseWidth;
+    float pixelMinY = glm::clamp(ndcMin.y * 0.5f + 0.5f, 0.0f, 1.0f) * pyramid.baseHeight;
+    float pixelMaxY = glm::clamp(ndcMax.y * 0.5f + 0.5f, 0.0f, 1.0f) * pyramid.baseHeight;
+
+    // 选择使屏幕矩形最多覆盖 2x2 纹素的级别；回读的最细一级更粗时改用它，逐个取覆盖的纹素
+    float extent = std::max(std::max(pixelMaxX - pixelMinX, pixelMaxY - pixelMinY), 1.0f);
+    int level = (int)std::ceil(std::log2(extent));
+    level = std::max(level, pyramid.firstLevel) - pyramid.firstLevel;
+    level = std::min(level, (int)pyramid.levels.size() - 1);
+    int shift = level + pyramid.firstLevel;
+
+    int width = pyramid.widths[level], height = pyramid.heights[level];
+    int x0 = std::min((int)pixelMinX >> shift, width - 1), x1 = std::min((int)pixelMaxX >> shift, width - 1);
+    int y0 = std::min((int)pixelMinY >> shift, height - 1), y1 = std::min((int)pixelMaxY >> shift, height - 1);
+
+    const std::vector<float>& depths = pyramid.levels[level];
+    float maxDepth = 0.0f;
+    for (int y = y0; y <= y1; y++)
+        for (int x = x0; x <= x1; x++)
+            maxDepth = std::max(maxDepth, depths[(size_t)y * width + x]);
+
+    return ndcMin.z * 0.5f + 0.5f > maxDepth;
+}
+
+
+bool HiZBuffer::init() {
+    bool linked = linkProgram(depthProgram, occluderVertexShader, occluderFragmentShader);
+    linked = linkProgram(reduceProgram, reduceVertexShader, reduceFragmentShader) && linked;
+    glGenVertexArrays(1, &emptyVAO);
+    glGenFramebuffers(1, &framebuffer);
+    available = linked;
+    return linked;
+}
+
+void HiZBuffer::createTargets(int width, int height) {
+    if (depthTexture)
+        glDeleteTextures(1, &depthTexture);
+
+    pyramidWidth = width;
+    pyramidHeight = height;
+    levels = 1;
+    while ((std::max(width, height) >> levels) > 0)
+        levels++;
+
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    for (int level = 0; level < levels; level++)
+        glTexImage2D(GL_TEXTURE_2D, level, GL_DEPTH_COMPONENT32F, std::max(1, width >> level), std::max(1, height >> level),
+                     0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // 回读级别与对应的 PBO
+    readbackLevel = 0;
+    while (readbackLevel + 1 < levels && (width >> readbackLevel) > kReadbackMaxWidth)
+        readbackLevel++;
+    readbackWidth = std::max(1, width >> readbackLevel);
+    readbackHeight = std::max(1, height >> readbackLevel);
+    for (int slot = 0; slot < READBACK_SLOTS; slot++) {
+        if (readbackFences[slot]) {
+            glDeleteSync(readbackFences[slot]);
+            readbackFences[slot] = 0;
+        }
+        if (!readbackBuffers[slot])
+            glGenBuffers(1, &readbackBuffers[slot]);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[slot]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)readbackWidth * readbackHeight * sizeof(float), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    cpuPyramid = DepthPyramid();
+}
+
+void HiZBuffer::beginOccluders(int width, int height) {
+    if (width != pyramidWidth || height != pyramidHeight || !depthTexture)
+        createTargets(width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glViewport(0, 0, width, height);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glUseProgram(depthProgram.id);
+}
+
+void HiZBuffer::buildPyramid() {
+    glUseProgram(reduceProgram.id);
+    glBindVertexArray(emptyVAO);
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_HIZ);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glDepthFunc(GL_ALWAYS);
+
+    // 读取第 level-1 级、写入第 level 级：采样范围限制在上一级，避免读写同一级形成反馈
+    for (int level = 1; level < levels; level++) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, level);
+        glViewport(0, 0, std::max(1, pyramidWidth >> level), std::max(1, pyramidHeight >> level));
+        glUniform2i(reduceProgram[U_HIZ_PREVIOUS_SIZE], std::max(1, pyramidWidth >> (level - 1)), std::max(1, pyramidHeight >> (level - 1)));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glDepthFunc(GL_LESS);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+}
+
+void HiZBuffer::endOccluders(const glm::mat4& viewProjection, bool readback) {
+    buildPyramid();
+    if (readback)
+        startReadback(viewProjection);
+}
+
+// 取回某个槽位已完成的回读；GPU 尚未完成时不等待
+bool HiZBuffer::collectReadback(int slot) {
+    if (!readbackFences[slot])
+        return false;
+    if (glClientWaitSync(readbackFences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+        return false;
+    glDeleteSync(readbackFences[slot]);
+    readbackFences[slot] = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[slot]);
+    size_t count = (size_t)readbackWidth * readbackHeight;
+    const float* depths = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+    if (depths) {
+        cpuPyramid.baseWidth = pyramidWidth;
+        cpuPyramid.baseHeight = pyramidHeight;
+        cpuPyramid.firstLevel = readbackLevel;
+        cpuPyramid.viewProjection = readbackViewProjection[slot];
+        cpuPyramid.levels.assign(1, std::vector<float>(depths, depths + count));
+        cpuPyramid.widths.assign(1, readbackWidth);
+        cpuPyramid.heights.assign(1, readbackHeight);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        buildDepthPyramid(cpuPyramid);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return depths != nullptr;
+}
+
+void HiZBuffer::startReadback(const glm::mat4& viewProjection) {
+    // 先收取上一帧发起的回读（最新），再把本帧的结果写入空闲槽位
+    int slot = readbackFrame % READBACK_SLOTS;
+    collectReadback((slot + READBACK_SLOTS - 1) % READBACK_SLOTS);
+    if (readbackFences[slot] && !collectReadback(slot))
+        return; // GPU 落后两帧以上：本帧不再排队
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[slot]);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glGetTexImage(GL_TEXTURE_2D, readbackLevel, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readbackViewProjection[slot] = viewProjection;
+    readbackFrame++;
+}
+
+size_t HiZBuffer::cullOccluded(const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+                               size_t count, uint8_t* visible) const {
+    if (cpuPyramid.empty())
+        return 0;
+
+    size_t culled = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (visible[i] && sphereOccluded(cpuPyramid, glm::vec3(centerX[i], centerY[i], centerZ[i]), radius[i])) {
+            visible[i] = 0;
+            culled++;
+        }
+    }
+    return culled;
+}
+
+void HiZBuffer::release() {
+    for (int slot = 0; slot < READBACK_SLOTS; slot++) {
+        if (readbackFences[slot])
+            glDeleteSync(readbackFences[slot]);
+        readbackFences[slot] = 0;
+    }
+    glDeleteBuffers(READBACK_SLOTS, readbackBuffers);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteVertexArrays(1, &emptyVAO);
+    glDeleteProgram(depthProgram.id);
+    glDeleteProgram(reduceProgram.id);
+    memset(readbackBuffers, 0, sizeof(readbackBuffers));
+    depthTexture = framebuffer = emptyVAO = 0;
+    pyramidWidth = pyramidHeight = levels = 0;
+    available = false;
+    cpuPyramid = DepthPyramid();
+}
@@ -0,0 +1,78 @@
+﻿#ifndef _HIZ_H_
+#define _HIZ_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "shader_program.h"
+
+// CPU 端的最大值深度金字塔：levels[0] 对应 GPU 金字塔的第 firstLevel 级，之后每级宽高减半
+struct DepthPyramid {
+    int baseWidth = 0, baseHeight = 0;  // GPU 金字塔第 0 级（即视口）的尺寸
+    int firstLevel = 0;
+    std::vector<int> widths, heights;
+    std::vector<std::vector<float> > levels;
+    glm::mat4 viewProjection = glm::mat4(1.0f); // 生成这份深度时的矩阵
+
+    bool empty() const { return levels.empty(); }
+};
+
+// 由 levels[0] 逐级取 2x2（奇数边多取一行/列）最大值，生成其余级别
+void buildDepthPyramid(DepthPyramid& pyramid);
+
+// 包围球是否被金字塔中的遮挡体完全挡住（保守：跨过相机平面或超出屏幕的部分按可见处理）
+bool sphereOccluded(const DepthPyramid& pyramid, const glm::vec3& center, float radius);
+
+// 层次 Z 缓冲：先只画大遮挡体（地板、地形、OBJECT_OCCLUDER 对象）的深度，
+// 再逐级取最大值生成 MIP 金字塔。GPU 驱动路径在剔除计算着色器中直接采样；
+// CPU 路径通过 PBO 异步回读较低分辨率的一级，下一帧起用于测试（延迟一帧）
+class HiZBuffer {
+public:
+    bool init();
+    bool isAvailable() const { return available; }
+    bool isReady() const { return depthTexture != 0; }
+
+    // 绑定遮挡体 FBO 与仅深度的着色器（尺寸变化时重建），调用者随后设置 U_MODEL 并绘制遮挡体
+    void beginOccluders(int width, int height);
+    const ShaderProgram& occluderProgram() const { return depthProgram; }
+
+    // 生成金字塔；readback 为 true 时同时发起异步回读供 cullOccluded 使用
+    void endOccluders(const glm::mat4& viewProjection, bool readback);
+
+    GLuint texture() const { return depthTexture; }
+    int width() const { return pyramidWidth; }
+    int height() const { return pyramidHeight; }
+    int levelCount() const { return levels; }
+
+    // CPU 路径：把已回读金字塔判为被遮挡的对象从 visible 中去掉，返回去掉的数量
+    size_t cullOccluded(const float* centerX, const float* centerY, const float* centerZ, const float* radius,
+                        size_t count, uint8_t* visible) const;
+
+    void release();
+
+private:
+    static const int READBACK_SLOTS = 2;
+
+    bool available = false;
+    ShaderProgram depthProgram, reduceProgram;
+    GLuint framebuffer = 0, depthTexture = 0, emptyVAO = 0;
+    int pyramidWidth = 0, pyramidHeight = 0, levels = 0;
+
+    GLuint readbackBuffers[READBACK_SLOTS] = {};
+    GLsync readbackFences[READBACK_SLOTS] = {};
+    glm::mat4 readbackViewProjection[READBACK_SLOTS];
+    int readbackLevel = 0, readbackWidth = 0, readbackHeight = 0;
+    int readbackFrame = 0;
+    DepthPyramid cpuPyramid;
+
+    void createTargets(int width, int height);
+    void buildPyramid();
+    void startReadback(const glm::mat4& viewProjection);
+    bool collectReadback(int slot);
+};
+
+extern HiZBuffer hiZBuffer;
+
+#endif
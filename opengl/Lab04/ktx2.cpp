@@ -0,0 +1,295 @@
+﻿#include "ktx2.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+static const uint8_t kKtx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// 读取时接受的最大尺寸（GL 4.x 常见的 GL_MAX_TEXTURE_SIZE / GL_MAX_ARRAY_TEXTURE_LAYERS）
+static const uint32_t kKtx2MaxDimension = 16384;
+static const uint32_t kKtx2MaxLayers = 2048;
+
+struct Ktx2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat, typeSize;
+    uint32_t pixelWidth, pixelHeight, pixelDepth;
+    uint32_t layerCount, faceCount, levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset, dfdByteLength;
+    uint32_t kvdByteOffset, kvdByteLength;
+    uint64_t sgdByteOffset, sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset, byteLength, uncompressedByteLength;
+};
+
+// 数据格式描述（Khronos Data Format）中用到的常量
+static const uint8_t KHR_DF_MODEL_RGBSDA = 1;
+static const uint8_t KHR_DF_MODEL_BC1A = 128;
+static const uint8_t KHR_DF_MODEL_BC3 = 130;
+static const uint8_t KHR_DF_MODEL_BC5 = 132;
+static const uint8_t KHR_DF_MODEL_BC7 = 134;
+static const uint8_t KHR_DF_PRIMARIES_BT709 = 1;
+static const uint8_t KHR_DF_TRANSFER_LINEAR = 1;
+static const uint8_t KHR_DF_TRANSFER_SRGB = 2;
+static const uint8_t KHR_DF_CHANNEL_ALPHA = 15;
+static const uint8_t KHR_DF_SAMPLE_LINEAR = 0x10;
+
+
+bool ktx2FormatInfo(uint32_t vkFormat, Ktx2FormatInfo& info) {
+    info = Ktx2FormatInfo();
+    switch (vkFormat) {
+    case KTX2_FORMAT_R8G8_UNORM:
+        info.blockBytes = 2;
+        info.channels = 2;
+        return true;
+    case KTX2_FORMAT_R8G8B8A8_UNORM:
+    case KTX2_FORMAT_R8G8B8A8_SRGB:
+        info.blockBytes = 4;
+        info.channels = 4;
+        info.srgb = vkFormat == KTX2_FORMAT_R8G8B8A8_SRGB;
+        return true;
+    case KTX2_FORMAT_BC1_RGB_UNORM:
+    case KTX2_FORMAT_BC1_RGB_SRGB:
+    case KTX2_FORMAT_BC3_UNORM:
+    case KTX2_FORMAT_BC3_SRGB:
+    case KTX2_FORMAT_BC5_UNORM:
+    case KTX2_FORMAT_BC7_UNORM:
+    case KTX2_FORMAT_BC7_SRGB:
+        info.blockWidth = info.blockHeight = 4;
+        info.compressed = true;
+        info.blockBytes = vkFormat <= KTX2_FORMAT_BC1_RGB_SRGB ? 8 : 16;
+        info.channels = vkFormat <= KTX2_FORMAT_BC1_RGB_SRGB ? 3 : vkFormat == KTX2_FORMAT_BC5_UNORM ? 2 : 4;
+        info.srgb = vkFormat == KTX2_FORMAT_BC1_RGB_SRGB || vkFormat == KTX2_FORMAT_BC3_SRGB || vkFormat == KTX2_FORMAT_BC7_SRGB;
+        return true;
+    default:
+        return false;
+    }
+}
+
+size_t Ktx2Texture::imageSize(int level) const {
+    Ktx2FormatInfo info;
+    ktx2FormatInfo(vkFormat, info);
+    size_t blocksX = (levelWidth(level) + info.blockWidth - 1) / info.blockWidth;
+    size_t blocksY = (levelHeight(level) + info.blockHeight - 1) / info.blockHeight;
+    return blocksX * blocksY * info.blockBytes;
+}
+
+template <class T>
+static void append(std::vector<uint8_t>& bytes, T value) {
+    const uint8_t* p = (const uint8_t*)&value;
+    bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+// 数据格式描述中的一个样本
+struct DfdSample {
+    uint16_t bitOffset;
+    uint8_t bitLength;
+    uint8_t channel;
+    uint32_t upper;
+};
+
+// 基本数据格式描述块：非压缩格式每个通道一个 8 位样本，压缩格式按块内各部分描述
+static std::vector<uint8_t> buildDataFormatDescriptor(uint32_t vkFormat, const Ktx2FormatInfo& info) {
+    uint8_t model = KHR_DF_MODEL_RGBSDA;
+    std::vector<DfdSample> samples;
+    if (!info.compressed) {
+        for (uint32_t s = 0; s < info.channels; s++) {
+            DfdSample sample = { (uint16_t)(s * 8), 8, (uint8_t)(s == 3 ? KHR_DF_CHANNEL_ALPHA : s), 255 };
+            samples.push_back(sample);
+        }
+    }
+    else if (vkFormat == KTX2_FORMAT_BC1_RGB_UNORM || vkFormat == KTX2_FORMAT_BC1_RGB_SRGB) {
+        model = KHR_DF_MODEL_BC1A;
+        DfdSample color = { 0, 64, 0, 0xFFFFFFFFu };
+        samples.push_back(color);
+    }
+    else if (vkFormat == KTX2_FORMAT_BC3_UNORM || vkFormat == KTX2_FORMAT_BC3_SRGB) {
+        model = KHR_DF_MODEL_BC3;
+        DfdSample alpha = { 0, 64, KHR_DF_CHANNEL_ALPHA, 0xFFFFFFFFu };
+        DfdSample color = { 64, 64, 0, 0xFFFFFFFFu };
+        samples.push_back(alpha);
+        samples.push_back(color);
+    }
+    else if (vkFormat == KTX2_FORMAT_BC5_UNORM) {
+        model = KHR_DF_MODEL_BC5;
+        DfdSample red = { 0, 64, 0, 0xFFFFFFFFu };
+        DfdSample green = { 64, 64, 1, 0xFFFFFFFFu };
+        samples.push_back(red);
+        samples.push_back(green);
+    }
+    else {
+        model = KHR_DF_MODEL_BC7;
+        DfdSample color = { 0, 128, 0, 0xFFFFFFFFu };
+        samples.push_back(color);
+    }
+
+    std::vector<uint8_t> block;
+    append<uint32_t>(block, 0);                             // vendorId = 0, descriptorType = 0
+    append<uint16_t>(block, 2);                             // versionNumber
+    append<uint16_t>(block, (uint16_t)(24 + 16 * samples.size())); // descriptorBlockSize
+    block.push_back(model);
+    block.push_back(KHR_DF_PRIMARIES_BT709);
+    block.push_back(info.srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR);
+    block.push_back(0);                                     // flags：直通 alpha
+    const uint8_t dimensions[4] = { (uint8_t)(info.blockWidth - 1), (uint8_t)(info.blockHeight - 1), 0, 0 };
+    block.insert(block.end(), dimensions, dimensions + 4);
+    uint8_t bytesPlane[8] = { (uint8_t)info.blockBytes };
+    block.insert(block.end(), bytesPlane, bytesPlane + 8);
+
+    for (size_t s = 0; s < samples.size(); s++) {
+        const DfdSample& sample = samples[s];
+        bool alpha = sample.channel == KHR_DF_CHANNEL_ALPHA;
+        append<uint16_t>(block, sample.bitOffset);
+        block.push_back((uint8_t)(sample.bitLength - 1));
+        // sRGB 格式的 alpha 是线性的
+        block.push_back((uint8_t)(sample.channel | (alpha && info.srgb ? KHR_DF_SAMPLE_LINEAR : 0)));
+        append<uint32_t>(block, 0);                         // samplePosition
+        append<uint32_t>(block, 0);                         // sampleLower
+        append<uint32_t>(block, sample.upper);              // sampleUpper
+    }
+
+    std::vector<uint8_t> descriptor;
+    append<uint32_t>(descriptor, (uint32_t)(4 + block.size())); // dfdTotalSize
+    descriptor.insert(descriptor.end(), block.begin(), block.end());
+    return descriptor;
+}
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool writeKtx2(const std::string& path, const Ktx2Texture& texture, const std::string& writer) {
+    Ktx2FormatInfo info;
+    if (!ktx2FormatInfo(texture.vkFormat, info) || texture.levels.empty()) {
+        std::cerr << "Unsupported KTX2 texture: " << path << std::endl;
+        return false;
+    }
+
+    uint32_t levelCount = (uint32_t)texture.levels.size();
+    std::vector<uint8_t> dfd = buildDataFormatDescriptor(texture.vkFormat, info);
+
+    std::vector<uint8_t> kvd;
+    std::string key = "KTXwriter";
+    append<uint32_t>(kvd, (uint32_t)(key.size() + 1 + writer.size() + 1));
+    kvd.insert(kvd.end(), key.begin(), key.end());
+    kvd.push_back(0);
+    kvd.insert(kvd.end(), writer.begin(), writer.end());
+    kvd.push_back(0);
+    kvd.resize(alignUp(kvd.size(), 4), 0);
+
+    Ktx2Header header = {};
+    memcpy(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier));
+    header.vkFormat = texture.vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = texture.width;
+    header.pixelHeight = texture.height;
+    header.layerCount = texture.layers;
+    header.faceCount = texture.faces;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = (uint32_t)(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = (uint32_t)dfd.size();
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = (uint32_t)kvd.size();
+
+    // 各级数据从最小的一级开始存放，每级按 lcm(块大小, 4) 对齐
+    size_t alignment = info.blockBytes;
+    while (alignment % 4 != 0)
+        alignment += info.blockBytes;
+    std::vector<Ktx2LevelIndex> index(levelCount);
+    size_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for (int level = (int)levelCount - 1; level >= 0; level--) {
+        offset = alignUp(offset, alignment);
+        index[level].byteOffset = offset;
+        index[level].byteLength = texture.levels[level].size();
+        index[level].uncompressedByteLength = texture.levels[level].size();
+        offset += texture.levels[level].size();
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to write KTX2 file: " << path << std::endl;
+        return false;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)index.data(), index.size() * sizeof(Ktx2LevelIndex));
+    file.write((const char*)dfd.data(), dfd.size());
+    file.write((const char*)kvd.data(), kvd.size());
+
+    size_t written = header.kvdByteOffset + header.kvdByteLength;
+    for (int level = (int)levelCount - 1; level >= 0; level--) {
+        static const char padding[16] = {};
+        file.write(padding, index[level].byteOffset - written);
+        file.write((const char*)texture.levels[level].data(), texture.levels[level].size());
+        written = index[level].byteOffset + index[level].byteLength;
+    }
+    return (bool)file;
+}
+
+bool readKtx2(const std::string& path, Ktx2Texture& texture) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+
+    Ktx2Header header;
+    Ktx2FormatInfo info;
+    if (!file.read((char*)&header, sizeof(header)) || memcmp(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0) {
+        std::cerr << "Not a KTX2 file: " << path << std::endl;
+        return false;
+    }
+    if (header.supercompressionScheme != 0 || !ktx2FormatInfo(header.vkFormat, info) || header.pixelDepth > 1 ||
+        header.pixelWidth == 0 || header.pixelHeight == 0 || (header.faceCount != 1 && header.faceCount != 6)) {
+        std::cerr << "Unsupported KTX2 file (format " << header.vkFormat << "): " << path << std::endl;
+        return false;
+    }
+
+    // 头中的尺寸都来自文件，分配前先确认不超过完整 MIP 链与文件本身
+    uint32_t maxLevels = 1;
+    for (uint32_t side = std::max(header.pixelWidth, header.pixelHeight); side > 1; side >>= 1)
+        maxLevels++;
+    if (header.levelCount > maxLevels || header.pixelWidth > kKtx2MaxDimension || header.pixelHeight > kKtx2MaxDimension ||
+        header.layerCount > kKtx2MaxLayers) {
+        std::cerr << "KTX2 header is out of range: " << path << std::endl;
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = (uint64_t)file.tellg();
+    file.seekg(sizeof(header));
+
+    texture.vkFormat = header.vkFormat;
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.layers = header.layerCount;
+    texture.faces = header.faceCount;
+
+    // levelCount 为 0 表示由加载方生成 MIP，这里只读第 0 级
+    uint32_t levelCount = std::max(1u, header.levelCount);
+    std::vector<Ktx2LevelIndex> index(levelCount);
+    if (!file.read((char*)index.data(), index.size() * sizeof(Ktx2LevelIndex)))
+        return false;
+
+    uint64_t images = (uint64_t)std::max(1u, texture.layers) * texture.faces;
+    texture.levels.assign(levelCount, std::vector<uint8_t>());
+    for (uint32_t level = 0; level < levelCount; level++) {
+        uint64_t blocksX = (texture.levelWidth(level) + info.blockWidth - 1) / info.blockWidth;
+        uint64_t blocksY = (texture.levelHeight(level) + info.blockHeight - 1) / info.blockHeight;
+        uint64_t expected = blocksX * blocksY * info.blockBytes * images;
+        if (index[level].byteLength != expected) {
+            std::cerr << "KTX2 level " << level << " has unexpected size: " << path << std::endl;
+            return false;
+        }
+        if (index[level].byteLength > fileSize || index[level].byteOffset > fileSize - index[level].byteLength) {
+            std::cerr << "KTX2 level " << level << " lies outside the file: " << path << std::endl;
+            return false;
+        }
+        texture.levels[level].resize((size_t)expected);
+        file.seekg((std::streamoff)index[level].byteOffset);
+        if (!file.read((char*)texture.levels[level].data(), (std::streamsize)expected)) {
+            std::cerr << "Truncated KTX2 file: " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+﻿#ifndef _KTX2_H_
+#define _KTX2_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// KTX 2.0 容器的读写（不调用 OpenGL，离线工具与运行时共用）。
+// 只支持本项目用到的格式，不支持超压缩（supercompressionScheme 必须为 0）
+
+// 与 VkFormat 的取值一致
+enum Ktx2Format : uint32_t {
+    KTX2_FORMAT_R8G8_UNORM = 16,
+    KTX2_FORMAT_R8G8B8A8_UNORM = 37,
+    KTX2_FORMAT_R8G8B8A8_SRGB = 43,
+    KTX2_FORMAT_BC1_RGB_UNORM = 131,    // 4x4 块 8 字节：RGB565 端点 + 2 位索引
+    KTX2_FORMAT_BC1_RGB_SRGB = 132,
+    KTX2_FORMAT_BC3_UNORM = 137,        // 16 字节：BC4 alpha + BC1 颜色
+    KTX2_FORMAT_BC3_SRGB = 138,
+    KTX2_FORMAT_BC5_UNORM = 141,        // 16 字节：两个 BC4 通道（法线贴图的 XY）
+    KTX2_FORMAT_BC7_UNORM = 145,        // 16 字节：RGBA，多种分区/精度模式
+    KTX2_FORMAT_BC7_SRGB = 146,
+};
+
+struct Ktx2FormatInfo {
+    uint32_t blockWidth = 1, blockHeight = 1; // 压缩格式为 4x4
+    uint32_t blockBytes = 0;                  // 每个纹素（或块）的字节数
+    uint32_t channels = 0;
+    bool srgb = false;
+    bool compressed = false;
+};
+
+// 不支持的格式返回 false
+bool ktx2FormatInfo(uint32_t vkFormat, Ktx2FormatInfo& info);
+
+struct Ktx2Texture {
+    uint32_t vkFormat = 0;
+    uint32_t width = 0, height = 0;
+    uint32_t layers = 0;    // 0 表示非数组纹理
+    uint32_t faces = 1;     // 6 为立方体贴图（面顺序 +X -X +Y -Y +Z -Z）
+    std::vector<std::vector<uint8_t> > levels; // levels[l]：依次为每层、每面的图像，第 0 级最大
+
+    uint32_t levelWidth(int level) const { return width >> level ? width >> level : 1; }
+    uint32_t levelHeight(int level) const { return height >> level ? height >> level : 1; }
+
+    // 第 level 级单个图像（一层的一个面）的字节数
+    size_t imageSize(int level) const;
+};
+
+// writer 写入 KTXwriter 键值
+bool writeKtx2(const std::string& path, const Ktx2Texture& texture, const std::string& writer);
+bool readKtx2(const std::string& path, Ktx2Texture& texture);
+
+#endif
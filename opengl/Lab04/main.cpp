@@ -11,9 +11,27 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <string>
+#include <map>
+#include <future>
+#include "headless.h"
+#include "shader_program.h"
+#include "mesh.h"
+#include "scene.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+#include "texture_streamer.h"
+#include "terrain.h"
+#include "gpu_driven.h"
+#include "hiz.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "gbuffer.h"
+#include "postprocess.h"
 
 // 新增全局变量
-GLuint skyboxShader;  // 天空盒着色器程序
+ShaderProgram skyboxShader;  // 天空盒着色器程序
 GLuint skyboxVAO, skyboxVBO;  // 天空盒VAO/VBO
 GLuint cubeMapTexture;
 
@@ -32,6 +50,7 @@ enum EffectMode { REFLECTION, REFRACTION };
 EffectMode currentMode = REFLECTION;  // 当前效果模式
 bool chromaticAberration = false;     // 是否开启色散
 float FresnelRatio = 0.5f;            // 菲涅耳混合系数（0-1）
+glm::vec3 lightDirection = glm::vec3(0.5f, 1.0f, 0.3f); // 光源方向（世界空间）
 
 // 地板顶点数据
 float floorVertices[] = {
@@ -50,19 +69,14 @@ unsigned int floorIndices[] = {
 GLuint floorVAO, floorVBO, floorEBO, floorTexture;
 
 
-// 数据结构
-struct ModelData {
-    std::vector<float> vertices;   // 顶点数据
-    std::vector<float> normals;    // 法线数据
-    std::vector<float> texCoords;  // 纹理坐标数据
-    GLuint textureID = 0;          // 纹理 ID
-    GLuint normalMapTexture = 0;
-    glm::vec3 position = { 0.0f, 0.0f, 0.0f }; // 空间位置
-    size_t pointCount = 0;         // 顶点数量
-    glm::mat4 rotationMatrix = glm::mat4(1.0f); // 旋转矩阵，默认是单位矩阵
+// 立方体顶点数据（NDC坐标，已移除Z分量）
+// 天空盒的六个面
+const std::vector<std::string> skyboxFaces = {
+    "right.jpg", "left.jpg",
+    "top.jpg", "bottom.jpg",
+    "front.jpg", "back.jpg"
 };
 
-// 立方体顶点数据（NDC坐标，已移除Z分量）
 void initSkybox() {
     // 1. 创建立方体顶点数据
     // 立方体顶点数据（NDC坐标，已移除Z分量）
@@ -122,37 +136,8 @@ void initSkybox() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glBindVertexArray(0);
 
-    // 3. 加载立方体贴图纹理
-    std::vector<std::string> faces = {
-        "right.jpg", "left.jpg",
-        "top.jpg", "bottom.jpg",
-        "front.jpg", "back.jpg"
-    };
-
-    glGenTextures(1, &cubeMapTexture);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
-
-    // 加载6个面的图片
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-
-    // 设置纹理参数
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    // 3. 加载立方体贴图纹理（图片已在 initOpenGL 中预取）
+    cubeMapTexture = textureCache.acquireCubeMap(skyboxFaces);
 }
 
 
@@ -163,12 +148,10 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 view;
-uniform mat4 projection;
-
 void main() {
     TexCoords = aPos;
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // 移除视图矩阵的位移分量，天空盒始终包围相机
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww; // 使用最大深度值
 }
 
@@ -177,20 +160,23 @@ void main() {
 // 片段着色器
 const char* skyboxFragmentShader = R"(
 #version 330 core
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 normalOut; // G-buffer 法线：天空不参与折痕检测
 
 in vec3 TexCoords;
 
 uniform samplerCube skybox;
 
 void main() {
-    FragColor = texture(skybox, TexCoords);
+    FragColor = vec4(texture(skybox, TexCoords).rgb, 1.0); // 色调为 1：天空不加排线
+    normalOut = vec4(0.5, 0.5, 0.5, 0.0);
 }
 
 )";
 
-GLuint vao[9], vboVertices[9], vboNormals[9], vboTexCoords[9], shaderProgram;
-ModelData modelData[9];
+ShaderProgram shaderProgram;
+ShaderProgram depthPrepassProgram;  // 与 shaderProgram 共用顶点着色器，只写深度
+Scene scene;
 
 // 控制变量
 float cameraDistance = 10.0f;  // 视角距离
@@ -198,157 +184,46 @@ float cameraAngleX = 0.0f;     // 视角绕 X 轴旋转角度
 float cameraAngleY = 0.0f;     // 视角绕 Y 轴旋转角度
 float modelRotationY = 0.0f;   // 模型绕 Y 轴旋转角度
 
+// 输出目标：窗口模式下为默认帧缓冲 0，无窗口模式下为离屏 FBO
+HeadlessOptions headless;
+GLuint outputFramebuffer = 0;
+int viewportWidth = 800, viewportHeight = 600;
 
 
-ModelData loadHeightmap(const char* heightmapFile, glm::vec3 position, float scaleX, float scaleY, float scaleZ) {
-    ModelData data;
 
-    // 载入高度图
-    int width, height, nrChannels;
-    unsigned char* heightmapData = stbi_load(heightmapFile, &width, &height, &nrChannels, 0);
-    if (!heightmapData) {
-        std::cerr << "Error loading heightmap: " << heightmapFile << std::endl;
-        return data;
-    }
-
-    // 生成地形的顶点数据
-    for (int z = 0; z < height; z++) {
-        for (int x = 0; x < width; x++) {
-            // 获取每个像素的灰度值并映射到高度
-            float pixelHeight = (float)heightmapData[(z * width + x) * nrChannels] / 255.0f * scaleY;  // 归一化后乘以scaleY
-
-            // 生成顶点数据
-            data.vertices.push_back((float)x * scaleX);  // x 坐标
-            data.vertices.push_back(pixelHeight);        // y 坐标（高度）
-            data.vertices.push_back((float)z * scaleZ);  // z 坐标
-
-            // 对应法线（暂时用单位法线，稍后可能需要计算）
-            data.normals.push_back(0.0f);
-            data.normals.push_back(1.0f);
-            data.normals.push_back(0.0f);
-
-            // 默认的纹理坐标（这里可以根据需要进行调整）
-            data.texCoords.push_back((float)x / width);
-            data.texCoords.push_back((float)z / height);
-        }
-    }
-
-    // 计算顶点数量
-    data.pointCount = data.vertices.size() / 3;
+// GPU 驱动剔除与间接绘制（'g' 键切换，--no-gpu-driven 关闭；不支持 GL 4.3 时自动使用 CPU 路径）
+bool gpuDrivenEnabled = true;
 
-    // 设置地形的位置
-    data.position = position;
+// 层次 Z 遮挡剔除（'o' 键切换，--no-occlusion 关闭）
+bool occlusionCullingEnabled = true;
 
-    // 释放高度图数据
-    stbi_image_free(heightmapData);
+// 深度预渲染（'z' 键切换，--no-depth-prepass 关闭）：每个可见像素只运行一次昂贵的片段着色器
+bool depthPrepassEnabled = true;
 
-    std::cout << "Heightmap loaded: " << heightmapFile << std::endl;
-    std::cout << "Terrain size: " << width << "x" << height << std::endl;
-    std::cout << "Number of vertices: " << data.pointCount << std::endl;
+// 描边后处理的实现：默认计算着色器版本（'p' 键在三种实现间轮换以比较耗时，
+// --separable-post 改用可分离的片段着色器通道，--naive-post 使用二维单通道的参考实现）
+PostProcessMode postProcessMode = POST_MODE_COMPUTE;
 
-    return data;
-}
+// 地形（'t' 键切换，第一次开启时才加载高度图）
+Terrain terrain;
+bool terrainEnabled = false;
+std::string terrainFile = "heightmap.png"; // --heightmap 可指定 16 位 PNG、.r32 或 .hmt
 
-// 加载模型函数
-// 加载模型函数
-// 加载模型函数
-ModelData loadModel(const char* fileName, const char* textureFile = nullptr, const char* normalMapFile = nullptr, glm::vec3 position = { 0.0f, 0.0f, 0.0f }, float rotateX = 0.0f, float rotateY = 0.0f, float rotateZ = 0.0f) {
-    ModelData data;
-    data.position = position;
-    const aiScene* scene = aiImportFile(fileName, aiProcess_Triangulate | aiProcess_GenNormals);
-    if (!scene) {
-        std::cerr << "Error loading model: " << fileName << std::endl;
-        return data;
-    }
+void setTerrainEnabled(bool enabled) {
+    terrainEnabled = enabled;
+    if (!enabled || terrain.isReady())
+        return;
 
-    const aiMesh* mesh = scene->mMeshes[0];
-    data.pointCount = mesh->mNumVertices;
-
-    std::cout << "Model: " << fileName << " - Number of vertices: " << data.pointCount << std::endl;
-
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        const aiVector3D* pos = &mesh->mVertices[i];
-        const aiVector3D* norm = &mesh->mNormals[i];
-        const aiVector3D* texCoord = mesh->mTextureCoords[0] ? &mesh->mTextureCoords[0][i] : nullptr;
-
-        data.vertices.push_back(pos->x);
-        data.vertices.push_back(pos->y);
-        data.vertices.push_back(pos->z);
-        data.normals.push_back(norm->x);
-        data.normals.push_back(norm->y);
-        data.normals.push_back(norm->z);
-        if (texCoord) {
-            data.texCoords.push_back(texCoord->x);
-            data.texCoords.push_back(texCoord->y);
-        }
-        else {
-            data.texCoords.push_back(0.0f); // 默认纹理坐标
-            data.texCoords.push_back(0.0f);
-        }
+    // 以世界原点为中心铺开，位于地板下方
+    const float cellSize = 0.05f, heightScale = 8.0f;
+    if (!terrain.load(terrainFile.c_str(), glm::vec3(cellSize, heightScale, cellSize))) {
+        terrainEnabled = false;
+        return;
     }
-
-    // 加载漫反射纹理
-    if (textureFile) {
-        glGenTextures(1, &data.textureID);
-        glBindTexture(GL_TEXTURE_2D, data.textureID);
-
-        int textureWidth, textureHeight, nrChannels;
-        unsigned char* textureData = stbi_load(textureFile, &textureWidth, &textureHeight, &nrChannels, 0);
-        if (textureData) {
-            // 上传纹理数据到 GPU
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, textureWidth, textureHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, textureData);
-
-            // **生成 MIP Maps**
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            // 设置纹理参数（包括 MIP Mapping）
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // 启用 MIP Mapping
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(textureData);
-        }
-        else {
-            std::cerr << "Failed to load texture: " << textureFile << std::endl;
-            stbi_image_free(textureData);
-        }
-    }
-
-    // 加载法线贴图（如果提供了）
-    if (normalMapFile) {
-        glGenTextures(1, &data.normalMapTexture);
-        glBindTexture(GL_TEXTURE_2D, data.normalMapTexture);
-
-        int normalMapWidth, normalMapHeight, nrChannels;
-        unsigned char* normalMapData = stbi_load(normalMapFile, &normalMapWidth, &normalMapHeight, &nrChannels, 0);
-        if (normalMapData) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, normalMapWidth, normalMapHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, normalMapData);
-            glGenerateMipmap(GL_TEXTURE_2D); // **生成 MIP Maps**
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // 启用 MIP Mapping
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            stbi_image_free(normalMapData);
-        }
-        else {
-            std::cerr << "Failed to load normal map: " << normalMapFile << std::endl;
-            stbi_image_free(normalMapData);
-        }
-    }
-
-    aiReleaseImport(scene);
-
-    glm::mat4 rotation = glm::mat4(1.0f);
-    rotation = glm::rotate(rotation, glm::radians(rotateX), glm::vec3(1.0f, 0.0f, 0.0f));
-    rotation = glm::rotate(rotation, glm::radians(rotateY), glm::vec3(0.0f, 1.0f, 0.0f));
-    rotation = glm::rotate(rotation, glm::radians(rotateZ), glm::vec3(0.0f, 0.0f, 1.0f));
-    data.rotationMatrix = rotation;
-
-    return data;
+    terrain.position = glm::vec3(-terrain.boundsMax.x * 0.5f, -heightScale - 1.0f, -terrain.boundsMax.z * 0.5f);
+    terrain.upload();
 }
 
-
 // 顶点着色器源码
 const char* vertexShaderSource = R"(
 #version 330 core
@@ -356,140 +231,96 @@ layout(location = 0) in vec3 vertex_position;
 layout(location = 1) in vec3 vertex_normal;
 layout(location = 2) in vec2 vertex_texcoord; // 添加纹理坐标输入
 
+layout(location = 3) in mat4 instance_model; // 实例化绘制时的模型矩阵
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform bool useInstancing;
 
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec2 fragTexcoord; // 传递纹理坐标
+invariant gl_Position; // 深度预渲染与着色通道的深度必须逐位一致（GL_EQUAL）
 
 void main() {
-    fragPosition = vec3(model * vec4(vertex_position, 1.0));
-    fragNormal = mat3(transpose(inverse(model))) * vertex_normal;
+    mat4 modelMatrix = useInstancing ? instance_model : model;
+    fragPosition = vec3(modelMatrix * vec4(vertex_position, 1.0));
+    fragNormal = mat3(transpose(inverse(modelMatrix))) * vertex_normal;
     fragTexcoord = vertex_texcoord; // 传递纹理坐标
     gl_Position = projection * view * vec4(fragPosition, 1.0);
 }
 
 )";
 
-// 片段着色器源码
-// 修改片段着色器
+// 片段着色器源码：几何通道，输出固有色、素描色调与法线到 G-buffer，轮廓在全屏边缘检测通道中生成
 const char* fragmentShaderSource = R"(
 #version 330 core
 in vec3 fragPosition;
 in vec3 fragNormal;
 in vec2 fragTexcoord;
 
-uniform sampler2D textureSampler; // 纹理
-uniform vec3 lightDir; // 光源方向
-uniform vec3 viewPosition;
-uniform sampler2D strokeTexture; // 手绘笔触纹理
+uniform bool useTexture;
+uniform vec3 defaultColor;             // 无纹理批次的固有色
+uniform sampler2D textureSampler;      // 漫反射纹理
+uniform sampler2DArray strokeTexture; // 色调艺术图：第 i 层 R/G 为相邻两级排线色调
 
-out vec4 fragColor;
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec4 normalOut;
 
 void main() {
     // 计算光照
     vec3 normal = normalize(fragNormal);
-    vec3 light = normalize(lightDir);
+    vec3 light = normalize(lightDir.xyz);
     float intensity = max(dot(normal, light), 0.0);
 
-    // 轮廓检测（使用 Sobel 算子）
-    vec3 edgeColor = vec3(0.0);
-    vec2 texOffset = vec2(1.0 / 512.0, 1.0 / 512.0);
-    
-    float sobelX = 0.0;
-    sobelX += texture(textureSampler, fragTexcoord + texOffset * vec2(-1, -1)).r * -1.0;
-    sobelX += texture(textureSampler, fragTexcoord + texOffset * vec2(1, -1)).r * 1.0;
-    sobelX += texture(textureSampler, fragTexcoord + texOffset * vec2(-1, 1)).r * -1.0;
-    sobelX += texture(textureSampler, fragTexcoord + texOffset * vec2(1, 1)).r * 1.0;
-    
-    float sobelY = 0.0;
-    sobelY += texture(textureSampler, fragTexcoord + texOffset * vec2(-1, -1)).r * -1.0;
-    sobelY += texture(textureSampler, fragTexcoord + texOffset * vec2(-1, 1)).r * 1.0;
-    sobelY += texture(textureSampler, fragTexcoord + texOffset * vec2(1, -1)).r * -1.0;
-    sobelY += texture(textureSampler, fragTexcoord + texOffset * vec2(1, 1)).r * 1.0;
-
-    float edge = 1.0 - min(1.0, sqrt(sobelX * sobelX + sobelY * sobelY));
-
-    // 读取手绘笔触纹理
-    vec3 stroke = texture(strokeTexture, fragTexcoord * 5.0).rgb;
-
-    // 组合最终颜色（黑白素描风格）
-    vec3 finalColor = mix(vec3(1.0), stroke, intensity) * edge;
-
-    fragColor = vec4(finalColor, 1.0);
+    // 亮处排线稀疏、暗处密集：一次取样得到相邻两级色调，在其间插值
+    float tones = float(textureSize(strokeTexture, 0).z);
+    float darkness = (1.0 - intensity) * tones;
+    float layer = min(floor(darkness), tones - 1.0);
+    vec2 hatch = texture(strokeTexture, vec3(fragTexcoord * 5.0, layer)).rg;
+    float tone = mix(hatch.r, hatch.g, darkness - layer);
+
+    // 固有色与色调分开存放：合成默认只用色调输出黑白素描，固有色仅在开启着色（'c' 键）时参与
+    vec3 albedo = useTexture ? texture(textureSampler, fragTexcoord).rgb : defaultColor;
+    fragColor = vec4(albedo, tone);
+    normalOut = vec4(normal * 0.5 + 0.5, 1.0);
 }
 )";
 
 
-// 编译单个着色器
-GLuint compileShader(GLenum shaderType, const char* shaderSource) {
-    GLuint shader = glCreateShader(shaderType);
-    glShaderSource(shader, 1, &shaderSource, nullptr);
-    glCompileShader(shader);
-
-    // 检查编译错误
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char log[512];
-        glGetShaderInfoLog(shader, 512, nullptr, log);
-        std::cerr << "Shader compilation error: " << log << std::endl;
-    }
-
-    return shader;
+// 深度预渲染的片段着色器：不输出颜色
+const char* depthPrepassFragmentShaderSource = R"(
+#version 330 core
+void main() {
 }
+)";
+
 
+// 排线色调艺术图：由 StrokeGen 离线生成的 KTX2 数组纹理（--hatching 指定文件），一次上传全部 MIP
 GLuint strokeTexture;
+std::string hatchingFile = "hatching.ktx2";
+
 void loadStrokeTexture() {
-    glGenTextures(1, &strokeTexture);
-    glBindTexture(GL_TEXTURE_2D, strokeTexture);
-
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("stroke.jpg", &width, &height, &nrChannels, 0);
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(data);
-    }
-    else {
-        std::cerr << "Failed to load stroke texture" << std::endl;
-    }
+    strokeTexture = textureCache.acquireKtx2(hatchingFile);
+    if (strokeTexture)
+        return;
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // 文件缺失时退回 1x1 的白纸，画面只有描边
+    std::cerr << "Failed to load " << hatchingFile << ", run StrokeGen to generate it" << std::endl;
+    const unsigned char white[2] = { 255, 255 };
+    glGenTextures(1, &strokeTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, strokeTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RG8, 1, 1, 1, 0, GL_RG, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
 }
 
 
-// 初始化着色器程序
+// 初始化着色器程序：链接时缓存 uniform 位置，并创建每帧共享的 uniform 缓冲
 void initShaders() {
-    // 编译顶点着色器
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
-
-    // 编译片段着色器
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
-
-    // 链接着色器程序
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // 检查链接错误
-    GLint success;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        char log[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, log);
-        std::cerr << "Shader program linking error: " << log << std::endl;
-    }
-
-    // 删除着色器对象
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    initFrameUniforms();
+    linkProgram(shaderProgram, vertexShaderSource, fragmentShaderSource);
+    linkProgram(depthPrepassProgram, vertexShaderSource, depthPrepassFragmentShaderSource);
+    linkProgram(skyboxShader, skyboxVertexShader, skyboxFragmentShader);
 }
 
 void initFloor() {
@@ -523,34 +354,9 @@ void initFloor() {
     glBindVertexArray(0);
 
     // 加载地板纹理
-    glGenTextures(1, &floorTexture);
-    glBindTexture(GL_TEXTURE_2D, floorTexture);
-
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("floor.jpg", &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format;
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 3)
-            format = GL_RGB;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
+    floorTexture = textureCache.acquire2D("floor.jpg");
+    if (!floorTexture)
         std::cerr << "Failed to load floor texture" << std::endl;
-    }
-
-    stbi_image_free(data);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
 }
 
 
@@ -569,43 +375,14 @@ glm::mat4 getViewMatrix() {
 }
 
 
-glm::mat4 getProjectionMatrix() {
-    return glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-}
+// 投影的近、远平面（排序键的深度也按它归一化）
+const float kNearPlane = 0.1f;
+const float kFarPlane = 100.0f;
 
-// 初始化缓冲区
-void initBuffers() {
-    glGenVertexArrays(9, vao);
-    glGenBuffers(9, vboVertices);
-    glGenBuffers(9, vboNormals);
-    glGenBuffers(9, vboTexCoords); // 为纹理坐标生成缓冲区
-
-    for (int i = 0; i < 9; i++) {
-        glBindVertexArray(vao[i]);
-
-        // 顶点位置
-        glBindBuffer(GL_ARRAY_BUFFER, vboVertices[i]);
-        glBufferData(GL_ARRAY_BUFFER, modelData[i].vertices.size() * sizeof(float), modelData[i].vertices.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(0);
-
-        // 法线
-        glBindBuffer(GL_ARRAY_BUFFER, vboNormals[i]);
-        glBufferData(GL_ARRAY_BUFFER, modelData[i].normals.size() * sizeof(float), modelData[i].normals.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glEnableVertexAttribArray(1);
-
-        // 纹理坐标
-        glBindBuffer(GL_ARRAY_BUFFER, vboTexCoords[i]); // 绑定纹理坐标缓冲区
-        glBufferData(GL_ARRAY_BUFFER, modelData[i].texCoords.size() * sizeof(float), modelData[i].texCoords.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr); // 注意：纹理坐标是 2D
-        glEnableVertexAttribArray(2);
-
-        glBindVertexArray(0);
-    }
+glm::mat4 getProjectionMatrix() {
+    return glm::perspective(glm::radians(45.0f), (float)viewportWidth / (float)viewportHeight, kNearPlane, kFarPlane);
 }
 
-
 // 键盘控制
 void keypress(unsigned char key, int x, int y) {
     switch (key) {
@@ -641,6 +418,39 @@ void keypress(unsigned char key, int x, int y) {
     case 'q': yawAngle += 5.0f; break;    // 偏航向左
     case 'e': yawAngle -= 5.0f; break;    // 偏航向右
 
+    case 't':
+        setTerrainEnabled(!terrainEnabled);
+        std::cout << "Terrain " << (terrainEnabled ? "Enabled" : "Disabled") << std::endl;
+        break;
+
+    case 'g':
+        gpuDrivenEnabled = !gpuDrivenEnabled && gpuDriven.isAvailable();
+        std::cout << "GPU-driven rendering " << (gpuDrivenEnabled ? "Enabled" : "Disabled") << std::endl;
+        break;
+
+    case 'o':
+        occlusionCullingEnabled = !occlusionCullingEnabled && hiZBuffer.isAvailable();
+        std::cout << "Occlusion Culling " << (occlusionCullingEnabled ? "Enabled" : "Disabled") << std::endl;
+        break;
+
+    case 'z':
+        depthPrepassEnabled = !depthPrepassEnabled;
+        std::cout << "Depth Pre-pass " << (depthPrepassEnabled ? "Enabled" : "Disabled") << std::endl;
+        break;
+
+    case 'p':
+        postProcess.printTimings();
+        postProcessMode = (PostProcessMode)((postProcessMode + 1) % POST_MODE_COUNT);
+        if (postProcessMode == POST_MODE_COMPUTE && !postProcess.hasCompute())
+            postProcessMode = POST_MODE_NAIVE;
+        std::cout << "Post-process: " << postProcessModeName(postProcessMode) << std::endl;
+        break;
+
+    case 'c':
+        postProcess.albedoEnabled = !postProcess.albedoEnabled;
+        std::cout << "Albedo Tint " << (postProcess.albedoEnabled ? "Enabled" : "Disabled") << std::endl;
+        break;
+
     case 'b':
         bumpMappingEnabled = !bumpMappingEnabled;
         std::cout << "Bump Mapping " << (bumpMappingEnabled ? "Enabled" : "Disabled") << std::endl;
@@ -654,139 +464,282 @@ void keypress(unsigned char key, int x, int y) {
     glutPostRedisplay();
 }
 
-
-// 渲染函数
-void display() {
-    // 清除颜色缓冲区和深度缓冲区
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // 使用主着色器程序
-    glUseProgram(shaderProgram);
-
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, strokeTexture);
-    glUniform1i(glGetUniformLocation(shaderProgram, "strokeTexture"), 1);
-
-
-    // 获取 Shader 中的 Uniform 变量位置（提前获取，避免重复调用）
-    GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLuint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLuint projLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLuint viewPosLoc = glGetUniformLocation(shaderProgram, "viewPosition");
-    GLuint useTextureLoc = glGetUniformLocation(shaderProgram, "useTexture");
-    GLuint defaultColorLoc = glGetUniformLocation(shaderProgram, "defaultColor");
-    GLuint textureSamplerLoc = glGetUniformLocation(shaderProgram, "textureSampler");
-    GLuint bumpMappingLoc = glGetUniformLocation(shaderProgram, "bumpMappingEnabled");
-
-    // 设置视图矩阵和投影矩阵
-    glm::mat4 view = getViewMatrix();
-    glm::mat4 projection = getProjectionMatrix();
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glUniform3f(viewPosLoc, 0.0f, 0.0f, cameraDistance);
-
-    // 设置是否启用法线贴图（bump mapping）
-    glUniform1i(bumpMappingLoc, bumpMappingEnabled);
-
-    // 渲染地板
-    {
-        // 设置地板的模型矩阵
-        glm::mat4 floorModel = glm::mat4(1.0f); // 地板没有位移或旋转
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(floorModel));
-
-        // 绑定地板纹理并设置
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        glUniform1i(textureSamplerLoc, 0); // 将纹理绑定到纹理单元 0
-
-        // 通知 Shader 使用纹理
-        glUniform1i(useTextureLoc, 1);
-
-        // 绑定地板 VAO 并绘制
-        glBindVertexArray(floorVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+// 鼠标左键拾取：把点击位置反投影成世界空间射线，在场景 BVH 中找最近的对象
+void mouseClick(int button, int state, int x, int y) {
+    if (button != GLUT_LEFT_BUTTON || state != GLUT_DOWN)
+        return;
+
+    float ndcX = 2.0f * x / glutGet(GLUT_WINDOW_WIDTH) - 1.0f;
+    float ndcY = 1.0f - 2.0f * y / glutGet(GLUT_WINDOW_HEIGHT);
+    glm::mat4 inverseViewProjection = glm::inverse(getProjectionMatrix() * getViewMatrix());
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+
+    float distance;
+    ObjectHandle picked = scene.pickObject(origin, direction, &distance);
+    if (!scene.isAlive(picked)) {
+        std::cout << "Picked nothing" << std::endl;
+        return;
     }
+    std::cout << "Picked object " << picked.slot << " at distance " << distance * glm::length(direction) << std::endl;
+}
 
-    // 渲染模型
-    for (int i = 0; i < 9; i++) {
-        // 如果启用 bump mapping，则绑定法线贴图
-        if (bumpMappingEnabled && modelData[i].normalMapTexture) {
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, modelData[i].normalMapTexture);
-            glUniform1i(glGetUniformLocation(shaderProgram, "normalMap"), 1); // 将法线贴图绑定到纹理单元 1
-        }
 
-        // 设置模型矩阵
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), modelData[i].position); // 设置模型位置
-        model = model * modelData[i].rotationMatrix; // 应用模型的旋转矩阵
-        model = glm::rotate(model, modelRotationY, glm::vec3(0.0f, 1.0f, 0.0f)); // 应用 Y 轴旋转
+// 只有相机附近的遮挡体能挡住大片画面，更远的不画进金字塔
+const float kOccluderRange = 25.0f;
+std::vector<uint32_t> occluderCandidates;
 
-        // 对螺旋桨模型应用旋转（假设螺旋桨是 modelData[0]）
-        if (i == 0) {  // 假设螺旋桨在 modelData[0]
-            glm::mat4 propellerRotation = glm::rotate(glm::mat4(1.0f), glm::radians(propellerAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-            model = model * propellerRotation;  // 将旋转矩阵应用到螺旋桨模型
-        }
+// 遮挡体深度预渲染：只画地板、地形与相机附近、视锥内的 OBJECT_OCCLUDER 对象的深度，随后生成层次 Z 金字塔
+void renderOccluders(const glm::mat4& viewProjection, const Frustum& frustum, const glm::vec3& cameraPosition) {
+    hiZBuffer.beginOccluders(viewportWidth, viewportHeight);
+    const ShaderProgram& program = hiZBuffer.occluderProgram();
+
+    glm::mat4 floorModel = glm::mat4(1.0f);
+    glUniformMatrix4fv(program[U_MODEL], 1, GL_FALSE, glm::value_ptr(floorModel));
+    glBindVertexArray(floorVAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+
+    if (terrainEnabled) {
+        glm::mat4 terrainModel = glm::translate(glm::mat4(1.0f), terrain.position);
+        glUniformMatrix4fv(program[U_MODEL], 1, GL_FALSE, glm::value_ptr(terrainModel));
+        terrain.draw(frustum);
+    }
 
-        // 俯仰、横滚和偏航旋转
-        model = glm::rotate(model, glm::radians(pitchAngle), glm::vec3(1.0f, 0.0f, 0.0f));  // 俯仰旋转
-        model = glm::rotate(model, glm::radians(rollAngle), glm::vec3(0.0f, 0.0f, 1.0f));   // 横滚旋转
-        model = glm::rotate(model, glm::radians(yawAngle), glm::vec3(0.0f, 1.0f, 0.0f));    // 偏航旋转
+    // 候选遮挡体由 BVH 的包围盒查询给出，不必遍历全部对象
+    glm::vec3 reach(kOccluderRange);
+    scene.queryBox(cameraPosition - reach, cameraPosition + reach, occluderCandidates);
+    for (uint32_t i : occluderCandidates) {
+        if (!(scene.flags[i] & OBJECT_OCCLUDER) ||
+            !sphereInFrustum(frustum, glm::vec3(scene.sphereX[i], scene.sphereY[i], scene.sphereZ[i]), scene.sphereRadius[i]))
+            continue;
+        glUniformMatrix4fv(program[U_MODEL], 1, GL_FALSE, glm::value_ptr(scene.modelMatrices[i]));
+        drawMesh(scene.meshes[scene.meshIds[i]], program, false);
+    }
 
-        // 传递模型矩阵到着色器
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    // CPU 剔除路径需要回读金字塔（下一帧起生效）
+    hiZBuffer.endOccluders(viewProjection, !gpuDrivenEnabled);
+}
+
+// 到相机的距离按投影的近、远平面归一化到 [0, 1]，作为排序键的深度
+float sortDepth(float distance) {
+    return (distance - kNearPlane) / (kFarPlane - kNearPlane);
+}
 
-        // 判断是否有纹理
-        if (modelData[i].textureID) {
-            glUniform1i(useTextureLoc, 1); // 通知 Shader 使用纹理
-            glActiveTexture(GL_TEXTURE0);  // 激活纹理单元 0
-            glBindTexture(GL_TEXTURE_2D, modelData[i].textureID); // 绑定纹理
-            glUniform1i(textureSamplerLoc, 0); // 将纹理采样器绑定到纹理单元 0
+// 网格的每个材质批次生成一个绘制项（实例数据已由 bindInstanceRange 指向）
+void queueMesh(const ModelData& mesh, RenderPass pass, const ShaderProgram& program, bool depthOnly, GLsizei instanceCount, float depth) {
+    size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    size_t batchCount = mesh.batches.empty() ? 1 : mesh.batches.size();
+
+    for (size_t b = 0; b < batchCount; b++) {
+        RenderItem& item = renderQueue.add();
+        item.program = &program;
+        item.vao = mesh.vao;
+        item.instanced = true;
+        item.instanceCount = instanceCount;
+        item.indexType = mesh.ebo ? mesh.indexType : 0;
+
+        if (mesh.batches.empty()) {
+            // 高度图等没有批次的网格：整体绘制
+            item.mode = mesh.primitive;
+            item.count = (GLsizei)(mesh.ebo ? mesh.indexCount : mesh.pointCount);
+            item.primitiveRestart = mesh.ebo && mesh.primitive == GL_TRIANGLE_STRIP;
+            item.texture = mesh.textureID;
         }
         else {
-            glUniform1i(useTextureLoc, 0); // 通知 Shader 不使用纹理
-            glUniform3f(defaultColorLoc, 0.8f, 0.8f, 0.8f); // 设置默认颜色为灰色
+            const MeshBatch& batch = mesh.batches[b];
+            item.count = (GLsizei)batch.indexCount;
+            item.indexOffset = batch.firstIndex * indexSize;
+            item.texture = batch.textureID;
+            item.normalMap = bumpMappingEnabled ? batch.normalMapTexture : 0;
         }
 
-        // 绑定 VAO 并绘制
-        glBindVertexArray(vao[i]);
-        glDrawArrays(GL_TRIANGLES, 0, modelData[i].pointCount);
+        item.material = !depthOnly;
+        if (depthOnly)
+            item.key = depthSortKey(pass, depth, program.id, item.vao);
+        else
+            item.key = materialSortKey(pass, program.id, item.texture, item.vao, depth);
+    }
+}
+
+// 收集不透明物体的绘制项：场景对象、地板、地形。
+// 深度通道按由近到远排序以便提前深度测试；着色通道按程序/贴图/VAO 排序以减少状态切换
+void queueOpaque(RenderPass pass, const ShaderProgram& program, const Frustum& frustum) {
+    bool depthOnly = pass == PASS_DEPTH;
+
+    // 场景对象（剔除结果已在 display 中生成）
+    if (gpuDrivenEnabled) {
+        // 间接绘制使用自己的程序，作为一个整体排在通道最前
+        RenderItem& item = renderQueue.add();
+        item.key = depthOnly ? depthSortKey(pass, 0.0f, 0, 0) : materialSortKey(pass, 0, 0, 0, 0.0f);
+        if (depthOnly)
+            item.custom = []() { gpuDriven.drawDepth(); };
+        else
+            item.custom = []() { gpuDriven.draw(bumpMappingEnabled); };
+        item.customUniforms = depthOnly ? 0 : gpuDriven.drawProgramId();
+    }
+    // CPU 路径，以及 GPU 路径无法合并进池的网格
+    if (!gpuDrivenEnabled || gpuDriven.hasUnpooledMeshes()) {
+        for (const InstanceBatch& batch : scene.instanceBatches) {
+            if (gpuDrivenEnabled && gpuDriven.isPooled(batch.mesh))
+                continue;
+            const ModelData& mesh = scene.meshes[batch.mesh];
+            queueMesh(mesh, pass, program, depthOnly, batch.instanceCount, sortDepth(batch.distance));
+        }
     }
 
-    // 渲染天空盒
+    // 地板与地形覆盖整个场景，排在对象之后
     {
-        glDepthFunc(GL_LEQUAL);  // 修改深度测试比较方式
-        glUseProgram(skyboxShader);
+        RenderItem& item = renderQueue.add();
+        item.program = &program;
+        item.vao = floorVAO;
+        item.material = !depthOnly;
+        item.texture = floorTexture;
+        item.indexType = GL_UNSIGNED_INT;
+        item.count = 6;
+        item.key = depthOnly ? depthSortKey(pass, 1.0f, program.id, floorVAO)
+                             : materialSortKey(pass, program.id, floorTexture, floorVAO, 1.0f);
+    }
 
-        // 创建无位移的视图矩阵（关键修复点）
-        glm::mat4 skyboxView = glm::mat4(glm::mat3(view)); // 移除位移分量
+    // 地形（LOD 已在遮挡体预渲染之前选好），按块绘制由 terrain 自己完成
+    if (terrainEnabled) {
+        RenderItem& item = renderQueue.add();
+        item.program = &program;
+        item.material = !depthOnly;
+        item.model = glm::translate(glm::mat4(1.0f), terrain.position);
+        item.key = depthOnly ? depthSortKey(pass, 1.0f, program.id, 0)
+                             : materialSortKey(pass, program.id, 0, 0, 1.0f);
+        item.custom = [frustum]() { terrain.draw(frustum); };
+    }
+}
 
-        // 获取 uniform 位置（建议提前缓存这些位置）
-        GLint skyboxViewLoc = glGetUniformLocation(skyboxShader, "view");
-        GLint skyboxProjLoc = glGetUniformLocation(skyboxShader, "projection");
+// 渲染函数
+void display() {
+    // 在预算内推进流式纹理上传
+    textureStreamer.update();
+
+    // 每帧共享数据只上传一次
+    FrameUniforms frame;
+    frame.view = getViewMatrix();
+    frame.projection = getProjectionMatrix();
+    frame.viewPosition = glm::vec4(0.0f, 0.0f, cameraDistance, 1.0f);
+    frame.lightDir = glm::vec4(lightDirection, 0.0f);
+    updateFrameUniforms(frame);
+
+    // 世界空间视锥体，用于剔除地形块与场景对象
+    Frustum frustum = extractFrustum(frame.projection * frame.view);
+
+    // 所有对象共享的旋转（Y 轴旋转 + 俯仰、横滚、偏航）每帧只计算一次
+    glm::mat4 sharedRotation = glm::rotate(glm::mat4(1.0f), modelRotationY, glm::vec3(0.0f, 1.0f, 0.0f)); // 应用 Y 轴旋转
+    glm::mat4 attitude = glm::rotate(glm::mat4(1.0f), glm::radians(pitchAngle), glm::vec3(1.0f, 0.0f, 0.0f));  // 俯仰旋转
+    attitude = glm::rotate(attitude, glm::radians(rollAngle), glm::vec3(0.0f, 0.0f, 1.0f));   // 横滚旋转
+    attitude = glm::rotate(attitude, glm::radians(yawAngle), glm::vec3(0.0f, 1.0f, 0.0f));    // 偏航旋转
+
+    // 螺旋桨在 Y 轴旋转之后、姿态旋转之前额外旋转
+    glm::mat4 propellerRotation = glm::rotate(glm::mat4(1.0f), glm::radians(propellerAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+    scene.updateTransforms(sharedRotation * attitude, sharedRotation * propellerRotation * attitude);
+
+    // 相机位置取自观察矩阵的逆，调入可见的地形块后按距离选择 LOD
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(frame.view)[3]);
+    if (terrainEnabled) {
+        terrain.update(cameraPosition, frustum);
+        terrain.selectLod(cameraPosition, frustum);
+    }
 
-        // 绑定立方体贴图
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapTexture);
+    if (occlusionCullingEnabled) {
+        // 遮挡体预渲染直接写 U_MODEL，不经过状态缓存
+        renderOccluders(frame.projection * frame.view, frustum, cameraPosition);
+        glState.invalidateUniforms(hiZBuffer.occluderProgram().id);
+    }
 
-        // 传递矩阵（使用处理后的视图矩阵）
-        glUniformMatrix4fv(skyboxViewLoc, 1, GL_FALSE, glm::value_ptr(skyboxView));
-        glUniformMatrix4fv(skyboxProjLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // 剔除与实例数据每帧只生成一次，深度预渲染与着色通道共用
+    if (gpuDrivenEnabled) {
+        // 剔除与绘制命令都在 GPU 上生成
+        gpuDriven.cull(scene, frustum, occlusionCullingEnabled ? &hiZBuffer : nullptr);
+
+        // 未进网格池的网格（条带等）仍走 CPU 剔除与实例化绘制
+        if (gpuDriven.hasUnpooledMeshes()) {
+            scene.cullObjects(frustum);
+            scene.buildInstanceBatches(&cameraPosition);
+            for (const InstanceBatch& batch : scene.instanceBatches)
+                if (!gpuDriven.isPooled(batch.mesh))
+                    bindInstanceRange(scene.meshes[batch.mesh], scene.instanceBuffer, batch.firstInstance);
+        }
+    }
+    else {
+        scene.cullObjects(frustum);
+        if (occlusionCullingEnabled) {
+            // 用上一帧回读的金字塔去掉被挡住的对象
+            scene.visibleCount -= hiZBuffer.cullOccluded(scene.sphereX.data(), scene.sphereY.data(), scene.sphereZ.data(),
+                                                         scene.sphereRadius.data(), scene.objectCount(), scene.visible.data());
+        }
+
+        // 共享网格的对象合并为一次实例化绘制，由近到远排列以便提前深度测试
+        scene.buildInstanceBatches(&cameraPosition);
+
+        // 每个网格只有一个批次，实例范围在排序提交之前一次设好
+        for (const InstanceBatch& batch : scene.instanceBatches)
+            bindInstanceRange(scene.meshes[batch.mesh], scene.instanceBuffer, batch.firstInstance);
+    }
+
+    // 几何通道写入 G-buffer（固有色与色调、法线、深度），随后全屏描边合成到输出帧缓冲
+    gBuffer.beginGeometry(viewportWidth, viewportHeight);
+
+    // 场景全部不透明，关闭混合
+    glDisable(GL_BLEND);
+
+    // 整帧的绘制先收集进渲染队列，排序后统一提交
+    renderQueue.clear();
+
+    if (depthPrepassEnabled) {
+        // 先只写深度，着色通道用 GL_EQUAL 只对最终可见的像素运行片段着色器
+        PassState depthPass;
+        depthPass.colorWrite = false;
+        renderQueue.setPassState(PASS_DEPTH, depthPass);
+        queueOpaque(PASS_DEPTH, depthPrepassProgram, frustum);
+    }
 
-        // 渲染天空盒
-        glBindVertexArray(skyboxVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+    PassState opaquePass;
+    if (depthPrepassEnabled) {
+        opaquePass.depthFunc = GL_EQUAL;
+        opaquePass.depthWrite = false;
+    }
+    renderQueue.setPassState(PASS_OPAQUE, opaquePass);
+    queueOpaque(PASS_OPAQUE, shaderProgram, frustum);
 
-        // 恢复深度设置
-        glDepthFunc(GL_LESS);
-        glDepthMask(GL_TRUE); // 如果前面修改过需要恢复
+    // 天空盒（视图/投影矩阵来自 FrameData，着色器中移除位移分量），用 LEQUAL 画在远平面上
+    {
+        PassState skyPass;
+        skyPass.depthFunc = GL_LEQUAL;
+        renderQueue.setPassState(PASS_SKY, skyPass);
+
+        RenderItem& item = renderQueue.add();
+        item.program = &skyboxShader;
+        item.vao = skyboxVAO;
+        item.material = true;
+        item.textureTarget = GL_TEXTURE_CUBE_MAP;
+        item.texture = cubeMapTexture;
+        item.count = 36;
+        item.key = materialSortKey(PASS_SKY, skyboxShader.id, cubeMapTexture, skyboxVAO, 1.0f);
     }
 
-    // 交换缓冲区
-    glutSwapBuffers();
+    // 遮挡体预渲染、剔除与纹理上传直接修改过绑定；整帧共用的着色参数：笔触贴图、凹凸开关与无纹理批次的灰色
+    glState.invalidate();
+    glState.useProgram(shaderProgram.id);
+    glState.bindTexture(TEXTURE_UNIT_STROKE, GL_TEXTURE_2D_ARRAY, strokeTexture);
+    glState.setUniform1i(shaderProgram, U_BUMP_MAPPING, bumpMappingEnabled);
+    glState.setUniform3f(shaderProgram, U_DEFAULT_COLOR, glm::vec3(0.8f, 0.8f, 0.8f));
+
+    renderQueue.submit(glState);
+
+    // 屏幕空间描边、加粗、柔化后合成到输出帧缓冲
+    postProcess.run(gBuffer, outputFramebuffer, postProcessMode, glState);
+
+    // 交换缓冲区（无窗口模式下帧留在离屏 FBO 中，由调用方读取）
+    if (!headless.enabled)
+        glutSwapBuffers();
 }
 
 
@@ -794,53 +747,228 @@ void display() {
 
 
 
+// 等待加载的模型：文件读取与导入在线程池中进行，GL 上传在 finishModelRequests 中统一完成
+struct PendingMesh {
+    std::string textureFile, normalMapFile;
+    std::future<ModelData> model;
+};
+
+struct PendingObject {
+    std::string key;
+    glm::vec3 position;
+    glm::mat4 rotation;
+    uint32_t flags;
+};
+
+std::map<std::string, PendingMesh> pendingMeshes;
+std::vector<PendingObject> pendingObjects;
+
+// 请求把模型加入场景：同一文件 + 贴图组合只导入一次，后续对象共享网格并通过实例化绘制
+void requestModel(const char* fileName, const char* textureFile, const char* normalMapFile, glm::vec3 position, float rotateX, float rotateY, float rotateZ, uint32_t objectFlags = 0) {
+    std::string key = std::string(fileName) + "|" + (textureFile ? textureFile : "") + "|" + (normalMapFile ? normalMapFile : "");
+
+    if (scene.findMesh(key) == INVALID_MESH && pendingMeshes.find(key) == pendingMeshes.end()) {
+        PendingMesh& pending = pendingMeshes[key];
+        pending.textureFile = textureFile ? textureFile : "";
+        pending.normalMapFile = normalMapFile ? normalMapFile : "";
+
+        std::string file = fileName;
+        pending.model = workerPool().submit([file]() { return importModel(file.c_str()); });
+        if (textureFile)
+            textureCache.prefetch2D(textureFile);
+        if (normalMapFile)
+            textureCache.prefetch2D(normalMapFile);
+    }
+
+    PendingObject object;
+    object.key = key;
+    object.position = position;
+    object.rotation = eulerRotation(rotateX, rotateY, rotateZ);
+    object.flags = objectFlags;
+    pendingObjects.push_back(object);
+}
+
+// 在 GL 线程上等待导入结果，上传网格与贴图，并按请求顺序创建场景对象
+void finishModelRequests() {
+    for (const PendingObject& object : pendingObjects) {
+        MeshHandle mesh = scene.findMesh(object.key);
+        if (mesh == INVALID_MESH) {
+            std::map<std::string, PendingMesh>::iterator it = pendingMeshes.find(object.key);
+            if (it == pendingMeshes.end())
+                continue; // 加载失败的模型不占用场景对象
+
+            PendingMesh& pending = it->second;
+            ModelData model = pending.model.get();
+            if (model.pointCount > 0)
+                resolveModelTextures(model,
+                    pending.textureFile.empty() ? nullptr : pending.textureFile.c_str(),
+                    pending.normalMapFile.empty() ? nullptr : pending.normalMapFile.c_str());
+            pendingMeshes.erase(it);
+
+            if (model.pointCount == 0)
+                continue;
+            mesh = scene.addMesh(std::move(model), object.key);
+        }
+
+        scene.addObject(mesh, object.position, object.rotation, object.flags);
+    }
+
+    pendingObjects.clear();
+    pendingMeshes.clear();
+}
+
 // 初始化 OpenGL
 void initOpenGL() {
     glewInit();
     glEnable(GL_DEPTH_TEST);
     initShaders();
+    if (gpuDrivenEnabled)
+        gpuDrivenEnabled = gpuDriven.init(fragmentShaderSource);
+    if (!hiZBuffer.init())
+        occlusionCullingEnabled = false;
+    gBuffer.init();
+    if (!postProcess.init())
+        std::cerr << "Failed to link the post-process programs" << std::endl;
+    if (postProcessMode == POST_MODE_COMPUTE && !postProcess.hasCompute())
+        postProcessMode = POST_MODE_SEPARABLE;
+
+    auto loadStart = std::chrono::steady_clock::now();
+
+    // 1. 文件读取、图片解码和模型导入全部交给线程池并行进行
+    textureCache.prefetchCubeMap(skyboxFaces);
+    textureCache.prefetch2D("floor.jpg");
+
+    //requestModel("luoxuanjiang3.dae", "diffuse.jpg", nullptr, { 0.5f, -3.2f, 10.0f }, 180, 180, -90, OBJECT_PROPELLER);
+    //requestModel("plane2.obj", "plane3.jpg", "metal_normal.jpg", {0.0f, 2.5f, 0.0f}, 180, 180, 0);
+    requestModel("pink_cube.dae", "diffuse.jpg", nullptr, { 0.0f, 5.0f, 0.0f }, 0, 0, 0);
+    requestModel("pink_cube.dae", "diffuse.jpg", nullptr, { 5.0f, 5.0f, -10.0f }, 0, 0, 0);
+    requestModel("pink_cube.dae", "diffuse.jpg", nullptr, { 10.0f, 5.0f, -20.0f }, 0, 0, 0);
+    requestModel("pink_cube.dae", "diffuse.jpg", nullptr, { -8.0f, 5.0f, -30.0f }, 0, 0, 0);
+
+    // 2. GL 线程只负责上传，解码结果按需等待
     initSkybox();
     initFloor(); // 初始化地板
     loadStrokeTexture();
+    finishModelRequests();
+    setTerrainEnabled(terrainEnabled); // --terrain
+    textureCache.dropPrefetched();
+
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    std::cout << "Assets loaded in " << loadMs << " ms (" << workerPool().threadCount() << " worker threads)" << std::endl;
+}
 
-    // 创建天空盒着色器程序（替换原有错误代码）
-    skyboxShader = glCreateProgram();
-    GLuint vs = compileShader(GL_VERTEX_SHADER, skyboxVertexShader);
-    GLuint fs = compileShader(GL_FRAGMENT_SHADER, skyboxFragmentShader);
-    glAttachShader(skyboxShader, vs);
-    glAttachShader(skyboxShader, fs);
-    glLinkProgram(skyboxShader);
-
-    // 检查链接错误
-    GLint success;
-    glGetProgramiv(skyboxShader, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(skyboxShader, 512, NULL, infoLog);
-        std::cerr << "SKYBOX SHADER LINK ERROR: " << infoLog << std::endl;
-    }
 
-    // 清理着色器对象
-    glDeleteShader(vs);
-    glDeleteShader(fs);
 
+// 退出前释放 GL 资源：贴图按引用计数归还纹理缓存，之后才能关闭流式上传
+void releaseResources() {
+    for (ModelData& mesh : scene.meshes)
+        releaseModelTextures(mesh);
+    textureCache.release(floorTexture);
+    textureCache.release(cubeMapTexture);
+    textureCache.release(strokeTexture);
+    floorTexture = cubeMapTexture = strokeTexture = 0;
 
+    textureStreamer.shutdown();
+    gpuDriven.release();
+    hiZBuffer.release();
+    postProcess.printTimings();
+    postProcess.release();
+    gBuffer.release();
+    terrain.release();
+}
 
-    // 加载模型及其纹理
-    //modelData[0] = loadModel("luoxuanjiang3.dae", "diffuse.jpg", nullptr, { 0.5f, -3.2f, 10.0f }, 180, 180, -90);
-    //modelData[1] = loadModel("plane2.obj", "plane3.jpg", "metal_normal.jpg", {0.0f, 2.5f, 0.0f}, 180, 180, 0);
-    modelData[2] = loadModel("pink_cube.dae", "diffuse.jpg", nullptr, { 0.0f, 5.0f, 0.0f }, 0, 0, 0);
-    modelData[3] = loadModel("pink_cube.dae", "diffuse.jpg", nullptr, { 5.0f, 5.0f, -10.0f }, 0, 0, 0);
-    modelData[4] = loadModel("pink_cube.dae", "diffuse.jpg", nullptr, { 10.0f, 5.0f, -20.0f }, 0, 0, 0);
-    modelData[5] = loadModel("pink_cube.dae", "diffuse.jpg", nullptr, { -8.0f, 5.0f, -30.0f }, 0, 0, 0);
 
+// 无窗口批量渲染：沿固定的环绕相机路径渲染 N 帧并写入磁盘
+int runHeadless() {
+    if (!createHeadlessContext())
+        return 1;
 
-    initBuffers();
-}
+    viewportWidth = headless.width;
+    viewportHeight = headless.height;
+    outputFramebuffer = createOffscreenTarget(viewportWidth, viewportHeight);
+    initOpenGL();
+    textureStreamer.finish(); // 输出帧不应包含占位纹理
+
+    double renderSeconds = 0.0;
+    auto batchStart = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < headless.frameCount; i++) {
+        int frame = headless.firstFrame + i;
 
+        // 固定相机路径：绕场景一周，略微俯视
+        cameraAngleY = glm::radians(360.0f) * (float)frame / (float)headless.pathLength;
+        cameraAngleX = glm::radians(15.0f);
+
+        auto frameStart = std::chrono::steady_clock::now();
+        display();
+        glFinish();
+        renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%05d.ppm", frame);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, outputFramebuffer);
+        writeFramePPM(headless.outputDir + name, viewportWidth, viewportHeight);
+    }
+
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+    std::cout << "Rendered " << headless.frameCount << " frames (" << viewportWidth << "x" << viewportHeight << ") to "
+              << headless.outputDir << std::endl;
+    std::cout << "Render throughput: " << headless.frameCount / renderSeconds << " frames/s, "
+              << "including readback and disk: " << headless.frameCount / totalSeconds << " frames/s" << std::endl;
+    std::cout << "GL state changes per frame: " << glState.issuedChanges / headless.frameCount << " issued, "
+              << glState.filteredChanges / headless.frameCount << " filtered as redundant" << std::endl;
+
+    releaseResources();
+    destroyOffscreenTarget();
+    destroyHeadlessContext();
+    return 0;
+}
 
 
 int main(int argc, char** argv) {
+    if (!parseHeadlessArgs(argc, argv, headless))
+        return 1;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--packed-vertices")
+            meshVertexFormat = VERTEX_FORMAT_PACKED;
+        else if (std::string(argv[i]) == "--terrain")
+            terrainEnabled = true;
+        else if (std::string(argv[i]) == "--heightmap" && i + 1 < argc)
+            terrainFile = argv[++i];
+        else if (std::string(argv[i]) == "--convert-heightmap" && i + 2 < argc) {
+            // 离线转换为分块格式后直接退出
+            Heightfield field;
+            if (!loadHeightfield(argv[i + 1], field) || !writeTiledHeightfield(field, argv[i + 2])) {
+                std::cerr << "Failed to convert heightmap: " << argv[i + 1] << std::endl;
+                return 1;
+            }
+            std::cout << "Wrote tiled heightmap: " << argv[i + 2] << std::endl;
+            return 0;
+        }
+        else if (std::string(argv[i]) == "--hatching" && i + 1 < argc)
+            hatchingFile = argv[++i];
+        else if (std::string(argv[i]) == "--no-mesh-cache")
+            meshCacheEnabled = false;
+        else if (std::string(argv[i]) == "--no-compressed-textures")
+            compressedTexturesEnabled = false;
+        else if (std::string(argv[i]) == "--no-gpu-driven")
+            gpuDrivenEnabled = false;
+        else if (std::string(argv[i]) == "--no-occlusion")
+            occlusionCullingEnabled = false;
+        else if (std::string(argv[i]) == "--no-depth-prepass")
+            depthPrepassEnabled = false;
+        else if (std::string(argv[i]) == "--separable-post")
+            postProcessMode = POST_MODE_SEPARABLE;
+        else if (std::string(argv[i]) == "--naive-post")
+            postProcessMode = POST_MODE_NAIVE;
+        else if (std::string(argv[i]) == "--albedo")
+            postProcess.albedoEnabled = true;
+        else if (std::string(argv[i]) == "--stream-budget" && i + 1 < argc)
+            textureStreamer.setFrameBudget((size_t)atoi(argv[++i]) * 1024); // 每帧纹理上传 KB 数
+    }
+    if (headless.enabled)
+        return runHeadless();
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(800, 600);
@@ -849,6 +977,8 @@ int main(int argc, char** argv) {
     glutDisplayFunc(display);
     glutIdleFunc(display);
     glutKeyboardFunc(keypress);
+    glutMouseFunc(mouseClick);
+    glutCloseFunc(releaseResources);
     glutMainLoop();
     return 0;
 }
\ No newline at end of file
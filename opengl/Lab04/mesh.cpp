@@ -0,0 +1,576 @@
+﻿#include "mesh.h"
+#include "shader_program.h"
+#include "texture_cache.h"
+#include "mesh_cache.h"
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <string>
+
+VertexFormat meshVertexFormat = VERTEX_FORMAT_FLOAT;
+bool meshCacheEnabled = true;
+
+static const int kVertexCacheSize = 32;
+
+
+// float -> half（就近舍入，溢出为无穷大）
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent <= 0) {
+        // 非规格化数或下溢为 0
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        return (uint16_t)(sign | (mantissa >> (14 - exponent)));
+    }
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7c00);
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000)
+        half++; // 进位到指数也是正确的结果
+    return (uint16_t)half;
+}
+
+static uint32_t packSnorm10(float value) {
+    float clamped = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (uint32_t)((int32_t)std::round(clamped * 511.0f)) & 0x3ff;
+}
+
+static PackedVertex packVertex(const Vertex& v) {
+    PackedVertex packed;
+    packed.position[0] = floatToHalf(v.position[0]);
+    packed.position[1] = floatToHalf(v.position[1]);
+    packed.position[2] = floatToHalf(v.position[2]);
+    packed.position[3] = floatToHalf(1.0f);
+    packed.normal = packSnorm10(v.normal[0]) | (packSnorm10(v.normal[1]) << 10) | (packSnorm10(v.normal[2]) << 20);
+    packed.texCoord[0] = floatToHalf(v.texCoord[0]);
+    packed.texCoord[1] = floatToHalf(v.texCoord[1]);
+    return packed;
+}
+
+
+// Forsyth 评分：刚使用过的三个顶点固定得分，其余按缓存位置递减；剩余三角形越少越优先
+static float vertexCacheScore(int cachePosition, uint32_t remainingTriangles) {
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = powf(1.0f - (float)(cachePosition - 3) / (float)(kVertexCacheSize - 3), 1.5f);
+    }
+    return score + 2.0f / sqrtf((float)remainingTriangles);
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // 顶点 -> 三角形 邻接表
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices)
+        remaining[index]++;
+
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (uint32_t)t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = vertexCacheScore(-1, remaining[v]);
+
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    int cache[kVertexCacheSize + 3];
+    int cacheCount = 0;
+    size_t scanCursor = 0;
+    long bestTriangle = 0;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        if (bestTriangle < 0) {
+            // 缓存中没有候选三角形时，顺序取下一个未输出的三角形
+            while (emitted[scanCursor])
+                scanCursor++;
+            bestTriangle = (long)scanCursor;
+        }
+
+        const uint32_t* tri = &indices[bestTriangle * 3];
+        output.push_back(tri[0]);
+        output.push_back(tri[1]);
+        output.push_back(tri[2]);
+        emitted[bestTriangle] = true;
+
+        // 从三个顶点的活动三角形列表中移除
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = tri[k];
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + remaining[v];
+            for (uint32_t* it = begin; it != end; ++it) {
+                if (*it == (uint32_t)bestTriangle) {
+                    *it = *(end - 1);
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+
+        // 新缓存：当前三角形的顶点在前，其余按原顺序后移
+        int newCache[kVertexCacheSize + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; k++)
+            newCache[newCount++] = (int)tri[k];
+        for (int c = 0; c < cacheCount; c++) {
+            int v = cache[c];
+            if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+                newCache[newCount++] = v;
+        }
+
+        // 更新缓存中顶点的得分（超出容量的顶点被逐出）
+        for (int c = 0; c < newCount; c++) {
+            int v = newCache[c];
+            cachePosition[v] = c < kVertexCacheSize ? c : -1;
+            vertexScore[v] = vertexCacheScore(cachePosition[v], remaining[v]);
+        }
+
+        // 只需重新计算与缓存顶点相邻的三角形，并在其中挑选下一个
+        float bestScore = -1.0f;
+        bestTriangle = -1;
+        for (int c = 0; c < newCount; c++) {
+            int v = newCache[c];
+            for (uint32_t a = 0; a < remaining[v]; a++) {
+                uint32_t t = adjacency[offsets[v] + a];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = (long)t;
+                }
+            }
+        }
+
+        cacheCount = newCount < kVertexCacheSize ? newCount : kVertexCacheSize;
+        memcpy(cache, newCache, cacheCount * sizeof(int));
+    }
+
+    indices.swap(output);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    const uint32_t unassigned = 0xffffffffu;
+    std::vector<uint32_t> remap(vertices.size(), unassigned);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices) {
+        if (remap[index] == unassigned) {
+            remap[index] = (uint32_t)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    // 未被引用的顶点直接丢弃
+    vertices.swap(reordered);
+}
+
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize) {
+    if (indices.size() < 3)
+        return 0.0f;
+
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    size_t clock = 0, misses = 0;
+    for (uint32_t index : indices) {
+        // FIFO：顶点在最近 cacheSize 次插入之内视为命中
+        if (insertedAt[index] == 0 || clock - insertedAt[index] >= (size_t)cacheSize) {
+            clock++;
+            insertedAt[index] = clock;
+            misses++;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+
+// aiMatrix4x4 为行主序，glm 为列主序
+static glm::mat4 toGlm(const aiMatrix4x4& m) {
+    glm::mat4 result;
+    for (int r = 0; r < 4; r++)
+        for (int c = 0; c < 4; c++)
+            result[c][r] = m[r][c];
+    return result;
+}
+
+// 材质中的贴图路径相对于模型文件所在目录；内嵌贴图（"*0"）暂不支持
+static std::string resolveMaterialTexture(const aiMaterial* material, aiTextureType type, const std::string& directory) {
+    aiString path;
+    if (material->GetTextureCount(type) == 0 || material->GetTexture(type, 0, &path) != AI_SUCCESS)
+        return std::string();
+    if (path.data[0] == '*') {
+        std::cerr << "Embedded textures are not supported: " << path.C_Str() << std::endl;
+        return std::string();
+    }
+    return directory + path.C_Str();
+}
+
+// 深度优先遍历节点树，记录父子关系和世界变换
+static void collectNodes(const aiNode* node, int parent, const glm::mat4& parentWorld, std::vector<ModelNode>& nodes) {
+    ModelNode entry;
+    entry.name = node->mName.C_Str();
+    entry.parent = parent;
+    entry.localTransform = toGlm(node->mTransformation);
+    entry.worldTransform = parentWorld * entry.localTransform;
+    entry.meshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+    int index = (int)nodes.size();
+    nodes.push_back(entry);
+
+    glm::mat4 world = nodes[index].worldTransform;
+    for (unsigned int c = 0; c < node->mNumChildren; c++)
+        collectNodes(node->mChildren[c], index, world, nodes);
+}
+
+// 导入模型：遍历整个节点树，把所有网格按节点变换合并到同一个顶点缓冲中，
+// 使用相同材质的网格合并为一个批次（一次绘制、一次纹理绑定）
+static ModelData importScene(const char* fileName) {
+    ModelData data;
+    const aiScene* scene = aiImportFile(fileName, aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices);
+    if (!scene || !scene->mRootNode) {
+        std::cerr << "Error loading model: " << fileName << std::endl;
+        return data;
+    }
+
+    std::string path = fileName;
+    size_t slash = path.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+
+    // 材质：只记录贴图路径，GL 上传留给 resolveModelTextures
+    data.materials.resize(scene->mNumMaterials);
+    for (unsigned int m = 0; m < scene->mNumMaterials; m++) {
+        ModelMaterial& material = data.materials[m];
+        material.diffusePath = resolveMaterialTexture(scene->mMaterials[m], aiTextureType_DIFFUSE, directory);
+        material.normalPath = resolveMaterialTexture(scene->mMaterials[m], aiTextureType_NORMALS, directory);
+        if (material.normalPath.empty())
+            material.normalPath = resolveMaterialTexture(scene->mMaterials[m], aiTextureType_HEIGHT, directory);
+    }
+
+    collectNodes(scene->mRootNode, -1, glm::mat4(1.0f), data.nodes);
+
+    // 每个材质一组索引；节点引用的网格按节点的世界变换烘焙进顶点
+    std::vector<std::vector<uint32_t>> materialIndices(scene->mNumMaterials);
+    for (const ModelNode& node : data.nodes) {
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(node.worldTransform)));
+
+        for (unsigned int meshIndex : node.meshes) {
+            const aiMesh* mesh = scene->mMeshes[meshIndex];
+            if (!(mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE))
+                continue;
+
+            uint32_t baseVertex = (uint32_t)data.vertices.size();
+            data.vertices.resize(baseVertex + mesh->mNumVertices);
+
+            // 交错顶点（JoinIdenticalVertices 已经合并了相同的顶点）
+            for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+                glm::vec4 pos = node.worldTransform * glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f);
+                glm::vec3 norm = mesh->mNormals ? normalMatrix * glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f, 1.0f, 0.0f);
+                float normLength = glm::length(norm);
+                if (normLength > 0.0f)
+                    norm = norm / normLength;
+                const aiVector3D* texCoord = mesh->mTextureCoords[0] ? &mesh->mTextureCoords[0][i] : nullptr;
+
+                Vertex& v = data.vertices[baseVertex + i];
+                v.position[0] = pos.x;
+                v.position[1] = pos.y;
+                v.position[2] = pos.z;
+                v.normal[0] = norm.x;
+                v.normal[1] = norm.y;
+                v.normal[2] = norm.z;
+                v.texCoord[0] = texCoord ? texCoord->x : 0.0f; // 默认纹理坐标
+                v.texCoord[1] = texCoord ? texCoord->y : 0.0f;
+            }
+
+            std::vector<uint32_t>& indices = materialIndices[mesh->mMaterialIndex];
+            indices.reserve(indices.size() + mesh->mNumFaces * 3);
+            for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
+                const aiFace& face = mesh->mFaces[f];
+                if (face.mNumIndices != 3)
+                    continue; // 跳过三角化后剩下的点/线图元
+                indices.push_back(baseVertex + face.mIndices[0]);
+                indices.push_back(baseVertex + face.mIndices[1]);
+                indices.push_back(baseVertex + face.mIndices[2]);
+            }
+        }
+    }
+
+    // 每个材质的三角形单独做缓存优化，再拼接成一个索引缓冲
+    float acmrBefore = 0.0f, acmrAfter = 0.0f;
+    for (unsigned int m = 0; m < scene->mNumMaterials; m++) {
+        std::vector<uint32_t>& indices = materialIndices[m];
+        if (indices.empty())
+            continue;
+
+        acmrBefore += computeACMR(indices, data.vertices.size()) * (indices.size() / 3);
+        optimizeVertexCache(indices, data.vertices.size());
+        acmrAfter += computeACMR(indices, data.vertices.size()) * (indices.size() / 3);
+
+        MeshBatch batch;
+        batch.firstIndex = (uint32_t)data.indices.size();
+        batch.indexCount = (uint32_t)indices.size();
+        batch.materialIndex = (int)m;
+        data.batches.push_back(batch);
+        data.indices.insert(data.indices.end(), indices.begin(), indices.end());
+    }
+    optimizeVertexFetch(data.vertices, data.indices);
+
+    data.pointCount = data.vertices.size();
+    data.indexCount = data.indices.size();
+    if (!data.vertices.empty()) {
+        data.boundsMin = data.boundsMax = glm::vec3(data.vertices[0].position[0], data.vertices[0].position[1], data.vertices[0].position[2]);
+        for (const Vertex& v : data.vertices) {
+            glm::vec3 p(v.position[0], v.position[1], v.position[2]);
+            data.boundsMin = glm::min(data.boundsMin, p);
+            data.boundsMax = glm::max(data.boundsMax, p);
+        }
+
+        // 包围球：以包围盒中心为球心，半径取到最远顶点的距离（比半对角线更紧）
+        data.sphereCenter = (data.boundsMin + data.boundsMax) * 0.5f;
+        float radiusSq = 0.0f;
+        for (const Vertex& v : data.vertices) {
+            glm::vec3 offset = glm::vec3(v.position[0], v.position[1], v.position[2]) - data.sphereCenter;
+            radiusSq = std::max(radiusSq, glm::dot(offset, offset));
+        }
+        data.sphereRadius = std::sqrt(radiusSq);
+    }
+    size_t triangleCount = data.indexCount / 3;
+
+    std::cout << "Model: " << fileName << " - Number of vertices: " << data.pointCount
+              << ", triangles: " << triangleCount
+              << ", meshes: " << scene->mNumMeshes << ", nodes: " << data.nodes.size()
+              << ", batches: " << data.batches.size();
+    if (triangleCount > 0)
+        std::cout << ", ACMR: " << acmrBefore / triangleCount << " -> " << acmrAfter / triangleCount;
+    std::cout << std::endl;
+
+    aiReleaseImport(scene);
+    return data;
+}
+
+ModelData importModel(const char* fileName) {
+    std::string cachePath = std::string(fileName) + ".meshcache";
+    uint64_t sourceHash = meshCacheEnabled ? hashModelSource(fileName) : 0;
+
+    ModelData data;
+    if (sourceHash && readMeshCache(cachePath, sourceHash, data)) {
+        std::cout << "Model: " << fileName << " - Number of vertices: " << data.pointCount
+                  << ", triangles: " << data.indexCount / 3 << ", batches: " << data.batches.size()
+                  << " (mesh cache)" << std::endl;
+    }
+    else {
+        data = importScene(fileName);
+        if (sourceHash && data.pointCount > 0 && !writeMeshCache(cachePath, sourceHash, data))
+            std::cerr << "Failed to write mesh cache: " << cachePath << std::endl;
+    }
+
+    // 提前在线程池中解码材质贴图
+    for (const ModelMaterial& material : data.materials) {
+        if (!material.diffusePath.empty())
+            textureCache.prefetch2D(material.diffusePath);
+        if (!material.normalPath.empty())
+            textureCache.prefetch2D(material.normalPath);
+    }
+    return data;
+}
+
+void resolveModelTextures(ModelData& data, const char* textureFile, const char* normalMapFile) {
+    // 模型贴图流式上传：先以占位纹理绘制，MIP 在之后的帧中逐级到达
+    TextureSettings settings;
+    settings.streamed = true;
+
+    // 加载漫反射纹理 / 法线贴图：显式传入的贴图覆盖整个模型，否则使用各材质自己的贴图
+    if (textureFile)
+        data.textureID = textureCache.acquire2D(textureFile, settings);
+    if (normalMapFile)
+        data.normalMapTexture = textureCache.acquire2D(normalMapFile, settings);
+
+    for (MeshBatch& batch : data.batches) {
+        ModelMaterial& material = data.materials[batch.materialIndex];
+        if (!textureFile && !material.diffusePath.empty() && !material.textureID)
+            material.textureID = textureCache.acquire2D(material.diffusePath, settings);
+        if (!normalMapFile && !material.normalPath.empty() && !material.normalMapTexture)
+            material.normalMapTexture = textureCache.acquire2D(material.normalPath, settings);
+
+        batch.textureID = material.textureID ? material.textureID : data.textureID;
+        batch.normalMapTexture = material.normalMapTexture ? material.normalMapTexture : data.normalMapTexture;
+    }
+}
+
+void releaseModelTextures(ModelData& data) {
+    for (ModelMaterial& material : data.materials) {
+        textureCache.release(material.textureID);
+        textureCache.release(material.normalMapTexture);
+        material.textureID = material.normalMapTexture = 0;
+    }
+    textureCache.release(data.textureID);
+    textureCache.release(data.normalMapTexture);
+    data.textureID = data.normalMapTexture = 0;
+    for (MeshBatch& batch : data.batches)
+        batch.textureID = batch.normalMapTexture = 0;
+}
+
+// 加载模型函数
+ModelData loadModel(const char* fileName, const char* textureFile, const char* normalMapFile, glm::vec3 position, float rotateX, float rotateY, float rotateZ) {
+    ModelData data = importModel(fileName);
+    resolveModelTextures(data, textureFile, normalMapFile);
+    data.position = position;
+    data.rotationMatrix = eulerRotation(rotateX, rotateY, rotateZ);
+
+    return data;
+}
+
+glm::mat4 eulerRotation(float rotateX, float rotateY, float rotateZ) {
+    glm::mat4 rotation = glm::mat4(1.0f);
+    rotation = glm::rotate(rotation, glm::radians(rotateX), glm::vec3(1.0f, 0.0f, 0.0f));
+    rotation = glm::rotate(rotation, glm::radians(rotateY), glm::vec3(0.0f, 1.0f, 0.0f));
+    rotation = glm::rotate(rotation, glm::radians(rotateZ), glm::vec3(0.0f, 0.0f, 1.0f));
+    return rotation;
+}
+
+
+void setupVertexAttributes(VertexFormat format) {
+    if (format == VERTEX_FORMAT_PACKED) {
+        GLsizei stride = sizeof(PackedVertex);
+        glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, position));
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(PackedVertex, normal));
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, texCoord));
+    }
+    else {
+        GLsizei stride = sizeof(Vertex);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, normal));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, texCoord)); // 注意：纹理坐标是 2D
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+}
+
+void uploadMesh(ModelData& data) {
+    glGenVertexArrays(1, &data.vao);
+    glGenBuffers(1, &data.vbo);
+    glBindVertexArray(data.vao);
+
+    // 顶点：单个交错缓冲
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo);
+    // 来自网格缓存时直接从映射内存上传，不经过中间拷贝
+    const Vertex* vertices = data.vertexData();
+    if (meshVertexFormat == VERTEX_FORMAT_PACKED) {
+        std::vector<PackedVertex> packed(data.pointCount);
+        for (size_t i = 0; i < data.pointCount; i++)
+            packed[i] = packVertex(vertices[i]);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, data.pointCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+    }
+    setupVertexAttributes(meshVertexFormat);
+
+    // 索引：顶点数允许时使用 16 位索引（重启标记 0xffffffff 截断后正好是 0xffff）
+    if (data.indexCount > 0) {
+        const uint32_t* indices = data.indexData();
+        glGenBuffers(1, &data.ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.ebo);
+        if (data.pointCount <= 0xffff) {
+            std::vector<uint16_t> shortIndices(indices, indices + data.indexCount);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+            data.indexType = GL_UNSIGNED_SHORT;
+        }
+        else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indexCount * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+            data.indexType = GL_UNSIGNED_INT;
+        }
+    }
+
+    glBindVertexArray(0);
+}
+
+void bindInstanceRange(const ModelData& data, GLuint instanceBuffer, size_t firstInstance) {
+    glBindVertexArray(data.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    // mat4 按列拆成 4 个 vec4 属性，每个实例前进一次
+    size_t base = firstInstance * sizeof(glm::mat4);
+    for (GLuint c = 0; c < 4; c++) {
+        GLuint location = INSTANCE_MATRIX_LOCATION + c;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(base + c * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+}
+
+void drawMesh(const ModelData& data, const ShaderProgram& program, bool bindNormalMaps, GLsizei instanceCount) {
+    if (!data.vao)
+        return;
+
+    glBindVertexArray(data.vao);
+
+    // 高度图等没有批次的网格：整体绘制
+    if (data.batches.empty()) {
+        glUniform1i(program[U_USE_TEXTURE], data.textureID ? 1 : 0);
+        if (data.textureID) {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_DIFFUSE);
+            glBindTexture(GL_TEXTURE_2D, data.textureID);
+        }
+        bool restart = data.ebo && data.primitive == GL_TRIANGLE_STRIP;
+        if (restart) {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(data.indexType == GL_UNSIGNED_SHORT ? 0xffffu : 0xffffffffu);
+        }
+        if (data.ebo)
+            glDrawElementsInstanced(data.primitive, (GLsizei)data.indexCount, data.indexType, nullptr, instanceCount);
+        else
+            glDrawArraysInstanced(data.primitive, 0, (GLsizei)data.pointCount, instanceCount);
+        if (restart)
+            glDisable(GL_PRIMITIVE_RESTART);
+        return;
+    }
+
+    size_t indexSize = data.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    for (const MeshBatch& batch : data.batches) {
+        // 判断是否有纹理
+        glUniform1i(program[U_USE_TEXTURE], batch.textureID ? 1 : 0);
+        if (batch.textureID) {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_DIFFUSE);
+            glBindTexture(GL_TEXTURE_2D, batch.textureID);
+        }
+        if (bindNormalMaps && batch.normalMapTexture) {
+            glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_NORMAL_MAP);
+            glBindTexture(GL_TEXTURE_2D, batch.normalMapTexture);
+        }
+
+        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)batch.indexCount, data.indexType, (void*)(batch.firstIndex * indexSize), instanceCount);
+    }
+}
@@ -0,0 +1,135 @@
+﻿#ifndef _MESH_H_
+#define _MESH_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <memory>
+
+struct ShaderProgram;
+class MappedFile;
+
+// 交错顶点（CPU 端的标准格式，32 字节）
+struct Vertex {
+    float position[3];
+    float normal[3];
+    float texCoord[2];
+};
+
+// 压缩顶点（GPU 端可选格式，16 字节）：half 位置、2_10_10_10 snorm 法线、half 纹理坐标
+struct PackedVertex {
+    uint16_t position[4];   // half xyz + 对齐填充
+    uint32_t normal;        // GL_INT_2_10_10_10_REV
+    uint16_t texCoord[2];   // half uv
+};
+
+enum VertexFormat { VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_PACKED };
+
+// 上传到 GPU 时使用的顶点格式（--packed-vertices 启用压缩格式）
+extern VertexFormat meshVertexFormat;
+
+// 是否读写 <模型文件>.meshcache（--no-mesh-cache 关闭）
+extern bool meshCacheEnabled;
+
+// 一次绘制：共用同一材质的所有三角形在索引缓冲中连续存放
+struct MeshBatch {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int materialIndex = 0;
+    GLuint textureID = 0;
+    GLuint normalMapTexture = 0;
+};
+
+// 模型文件中的材质（贴图路径相对于模型文件解析）
+struct ModelMaterial {
+    std::string diffusePath;
+    std::string normalPath;
+    GLuint textureID = 0;
+    GLuint normalMapTexture = 0;
+};
+
+// 场景图节点：顶点已按 worldTransform 烘焙，这里保留层级以便查询
+struct ModelNode {
+    std::string name;
+    int parent = -1;
+    glm::mat4 localTransform = glm::mat4(1.0f);
+    glm::mat4 worldTransform = glm::mat4(1.0f);
+    std::vector<unsigned int> meshes;  // 引用的 aiMesh 下标
+};
+
+// 数据结构
+struct ModelData {
+    std::vector<Vertex> vertices;  // 去重后的交错顶点
+    std::vector<uint32_t> indices; // 三角形索引（为空时按非索引方式绘制）
+    GLuint textureID = 0;          // 纹理 ID
+    GLuint normalMapTexture = 0;
+    glm::vec3 position = { 0.0f, 0.0f, 0.0f }; // 空间位置
+    size_t pointCount = 0;         // 顶点数量
+    size_t indexCount = 0;         // 索引数量
+    GLenum primitive = GL_TRIANGLES; // GL_TRIANGLE_STRIP 时索引中含图元重启标记
+    glm::mat4 rotationMatrix = glm::mat4(1.0f); // 旋转矩阵，默认是单位矩阵
+    glm::vec3 boundsMin = glm::vec3(0.0f);      // 模型空间包围盒
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 sphereCenter = glm::vec3(0.0f);   // 模型空间包围球（球心取包围盒中心）
+    float sphereRadius = 0.0f;
+
+    std::vector<MeshBatch> batches;       // 按材质合并后的绘制批次
+    std::vector<ModelMaterial> materials;
+    std::vector<ModelNode> nodes;
+
+    // 从网格缓存加载时顶点与索引直接指向映射的文件，vertices/indices 保持为空
+    std::shared_ptr<MappedFile> mappedFile;
+    const Vertex* mappedVertices = nullptr;
+    const uint32_t* mappedIndices = nullptr;
+
+    const Vertex* vertexData() const { return mappedVertices ? mappedVertices : vertices.data(); }
+    const uint32_t* indexData() const { return mappedIndices ? mappedIndices : indices.data(); }
+
+    // GPU 资源（uploadMesh 创建）
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    GLenum indexType = GL_UNSIGNED_INT; // 顶点数不超过 65535 时使用 16 位索引
+};
+
+// 实例模型矩阵占用的顶点属性位置（mat4 占 3、4、5、6 四个位置）
+const GLuint INSTANCE_MATRIX_LOCATION = 3;
+
+// 依次绕 X、Y、Z 轴旋转（角度制）
+glm::mat4 eulerRotation(float rotateX, float rotateY, float rotateZ);
+
+// CPU 部分：导入模型并构建顶点/索引/批次，同时预取材质贴图。不调用 OpenGL，可在工作线程中执行
+// 源文件未变化时直接映射 .meshcache，跳过 Assimp
+ModelData importModel(const char* fileName);
+
+// GL 线程：为导入的模型加载贴图（显式传入的贴图覆盖材质贴图）
+void resolveModelTextures(ModelData& data, const char* textureFile, const char* normalMapFile);
+
+// 归还 resolveModelTextures 从纹理缓存取得的贴图（引用计数归零时删除）并清零句柄
+void releaseModelTextures(ModelData& data);
+
+// 加载模型函数
+ModelData loadModel(const char* fileName, const char* textureFile = nullptr, const char* normalMapFile = nullptr, glm::vec3 position = { 0.0f, 0.0f, 0.0f }, float rotateX = 0.0f, float rotateY = 0.0f, float rotateZ = 0.0f);
+
+// 按 Forsyth 的线性时间算法重排三角形以提高顶点后变换缓存命中率
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// 按索引中首次出现的顺序重排顶点，提高顶点读取的局部性
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// 模拟 FIFO 顶点缓存，返回平均每个三角形的缓存未命中次数（ACMR）
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize = 32);
+
+// 设置当前 VAO 的顶点属性（位置 0、法线 1、纹理坐标 2）
+void setupVertexAttributes(VertexFormat format);
+
+// 创建 VAO/VBO/EBO 并上传顶点与索引
+void uploadMesh(ModelData& data);
+
+// 把网格 VAO 的实例属性指向 instanceBuffer 中从 firstInstance 开始的模型矩阵
+void bindInstanceRange(const ModelData& data, GLuint instanceBuffer, size_t firstInstance);
+
+// 绘制已上传的网格：每个批次绑定一次纹理、一次 glDrawElementsInstanced
+void drawMesh(const ModelData& data, const ShaderProgram& program, bool bindNormalMaps, GLsizei instanceCount = 1);
+
+#endif
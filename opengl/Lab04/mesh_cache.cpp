@@ -0,0 +1,271 @@
+﻿#include "mesh_cache.h"
+#include "mapped_file.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <functional>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+static const char kMeshCacheMagic[4] = { 'M', 'S', 'H', 'C' };
+
+// 文件头之后依次是：顶点、索引、批次、材质、节点、节点网格下标、字符串表，每段按 8 字节对齐
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t vertexCount, indexCount, batchCount, materialCount;
+    uint32_t nodeCount, nodeMeshCount, stringBytes, reserved;
+    float boundsMin[3], boundsMax[3];
+    float sphereCenter[3], sphereRadius;
+    uint64_t vertexOffset, indexOffset, batchOffset, materialOffset;
+    uint64_t nodeOffset, nodeMeshOffset, stringOffset, fileSize;
+};
+
+struct CachedBatch {
+    uint32_t firstIndex, indexCount;
+    int32_t materialIndex;
+};
+
+// 字符串以 (偏移, 长度) 引用字符串表
+struct CachedMaterial {
+    uint32_t diffuseOffset, diffuseLength;
+    uint32_t normalOffset, normalLength;
+};
+
+struct CachedNode {
+    int32_t parent;
+    uint32_t nameOffset, nameLength;
+    uint32_t firstMesh, meshCount;
+    float localTransform[16];
+    float worldTransform[16];
+};
+
+
+static uint64_t fnv1a64(const void* bytes, size_t size, uint64_t hash) {
+    const unsigned char* p = (const unsigned char*)bytes;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashModelSource(const std::string& path) {
+    MappedFile source;
+    if (!source.open(path))
+        return 0;
+    uint64_t hash = fnv1a64(&MESH_CACHE_VERSION, sizeof(MESH_CACHE_VERSION), 14695981039346656037ull);
+    hash = fnv1a64(source.data(), source.size(), hash);
+    return hash ? hash : 1; // 0 保留给"没有源文件"
+}
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+// 检查 [offset, offset + count * stride) 是否落在文件内
+static bool sectionFits(uint64_t offset, uint64_t count, uint64_t stride, uint64_t fileSize) {
+    return offset <= fileSize && count <= (fileSize - offset) / stride;
+}
+
+
+bool readMeshCache(const std::string& cachePath, uint64_t sourceHash, ModelData& data) {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(cachePath) || file->size() < sizeof(MeshCacheHeader))
+        return false;
+
+    MeshCacheHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, kMeshCacheMagic, 4) != 0 || header.version != MESH_CACHE_VERSION ||
+        header.sourceHash != sourceHash || header.fileSize != file->size())
+        return false;
+
+    uint64_t size = file->size();
+    if (!sectionFits(header.vertexOffset, header.vertexCount, sizeof(Vertex), size) ||
+        !sectionFits(header.indexOffset, header.indexCount, sizeof(uint32_t), size) ||
+        !sectionFits(header.batchOffset, header.batchCount, sizeof(CachedBatch), size) ||
+        !sectionFits(header.materialOffset, header.materialCount, sizeof(CachedMaterial), size) ||
+        !sectionFits(header.nodeOffset, header.nodeCount, sizeof(CachedNode), size) ||
+        !sectionFits(header.nodeMeshOffset, header.nodeMeshCount, sizeof(uint32_t), size) ||
+        !sectionFits(header.stringOffset, header.stringBytes, 1, size))
+        return false;
+
+    const unsigned char* base = file->data();
+
+    // 越界的顶点索引会让 GPU 读到缓冲之外，视为缓存损坏
+    const uint32_t* indices = (const uint32_t*)(base + header.indexOffset);
+    for (uint32_t i = 0; i < header.indexCount; i++) {
+        if (indices[i] >= header.vertexCount)
+            return false;
+    }
+
+    const char* strings = (const char*)(base + header.stringOffset);
+    bool valid = true;
+    // 越界的字符串引用视为缓存损坏
+    auto readString = [&](uint32_t offset, uint32_t length) {
+        if (offset > header.stringBytes || length > header.stringBytes - offset) {
+            valid = false;
+            return std::string();
+        }
+        return std::string(strings + offset, length);
+    };
+
+    const CachedBatch* batches = (const CachedBatch*)(base + header.batchOffset);
+    data.batches.resize(header.batchCount);
+    for (uint32_t i = 0; i < header.batchCount; i++) {
+        if (batches[i].firstIndex > header.indexCount || batches[i].indexCount > header.indexCount - batches[i].firstIndex ||
+            batches[i].materialIndex < 0 || (uint32_t)batches[i].materialIndex >= header.materialCount)
+            return false;
+        data.batches[i].firstIndex = batches[i].firstIndex;
+        data.batches[i].indexCount = batches[i].indexCount;
+        data.batches[i].materialIndex = batches[i].materialIndex;
+    }
+
+    const CachedMaterial* materials = (const CachedMaterial*)(base + header.materialOffset);
+    data.materials.resize(header.materialCount);
+    for (uint32_t i = 0; i < header.materialCount; i++) {
+        data.materials[i].diffusePath = readString(materials[i].diffuseOffset, materials[i].diffuseLength);
+        data.materials[i].normalPath = readString(materials[i].normalOffset, materials[i].normalLength);
+    }
+
+    const CachedNode* nodes = (const CachedNode*)(base + header.nodeOffset);
+    const uint32_t* nodeMeshes = (const uint32_t*)(base + header.nodeMeshOffset);
+    data.nodes.resize(header.nodeCount);
+    for (uint32_t i = 0; i < header.nodeCount; i++) {
+        const CachedNode& cached = nodes[i];
+        if (cached.firstMesh > header.nodeMeshCount || cached.meshCount > header.nodeMeshCount - cached.firstMesh)
+            return false;
+        ModelNode& node = data.nodes[i];
+        node.name = readString(cached.nameOffset, cached.nameLength);
+        node.parent = cached.parent;
+        memcpy(glm::value_ptr(node.localTransform), cached.localTransform, sizeof(cached.localTransform));
+        memcpy(glm::value_ptr(node.worldTransform), cached.worldTransform, sizeof(cached.worldTransform));
+        node.meshes.assign(nodeMeshes + cached.firstMesh, nodeMeshes + cached.firstMesh + cached.meshCount);
+    }
+    if (!valid)
+        return false;
+
+    data.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    data.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    data.sphereCenter = glm::vec3(header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2]);
+    data.sphereRadius = header.sphereRadius;
+    data.pointCount = header.vertexCount;
+    data.indexCount = header.indexCount;
+    data.mappedVertices = (const Vertex*)(base + header.vertexOffset);
+    data.mappedIndices = (const uint32_t*)(base + header.indexOffset);
+    data.mappedFile = file;
+    return true;
+}
+
+
+bool writeMeshCache(const std::string& cachePath, uint64_t sourceHash, const ModelData& data) {
+    std::string strings;
+    auto addString = [&strings](const std::string& value, uint32_t& offset, uint32_t& length) {
+        offset = (uint32_t)strings.size();
+        length = (uint32_t)value.size();
+        strings += value;
+    };
+
+    std::vector<CachedBatch> batches(data.batches.size());
+    for (size_t i = 0; i < data.batches.size(); i++) {
+        batches[i].firstIndex = data.batches[i].firstIndex;
+        batches[i].indexCount = data.batches[i].indexCount;
+        batches[i].materialIndex = data.batches[i].materialIndex;
+    }
+
+    std::vector<CachedMaterial> materials(data.materials.size());
+    for (size_t i = 0; i < data.materials.size(); i++) {
+        addString(data.materials[i].diffusePath, materials[i].diffuseOffset, materials[i].diffuseLength);
+        addString(data.materials[i].normalPath, materials[i].normalOffset, materials[i].normalLength);
+    }
+
+    std::vector<CachedNode> nodes(data.nodes.size());
+    std::vector<uint32_t> nodeMeshes;
+    for (size_t i = 0; i < data.nodes.size(); i++) {
+        const ModelNode& node = data.nodes[i];
+        CachedNode& cached = nodes[i];
+        cached.parent = node.parent;
+        addString(node.name, cached.nameOffset, cached.nameLength);
+        cached.firstMesh = (uint32_t)nodeMeshes.size();
+        cached.meshCount = (uint32_t)node.meshes.size();
+        nodeMeshes.insert(nodeMeshes.end(), node.meshes.begin(), node.meshes.end());
+        memcpy(cached.localTransform, glm::value_ptr(node.localTransform), sizeof(cached.localTransform));
+        memcpy(cached.worldTransform, glm::value_ptr(node.worldTransform), sizeof(cached.worldTransform));
+    }
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMeshCacheMagic, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.vertexCount = (uint32_t)data.pointCount;
+    header.indexCount = (uint32_t)data.indexCount;
+    header.batchCount = (uint32_t)batches.size();
+    header.materialCount = (uint32_t)materials.size();
+    header.nodeCount = (uint32_t)nodes.size();
+    header.nodeMeshCount = (uint32_t)nodeMeshes.size();
+    header.stringBytes = (uint32_t)strings.size();
+    for (int axis = 0; axis < 3; axis++) {
+        header.boundsMin[axis] = data.boundsMin[axis];
+        header.boundsMax[axis] = data.boundsMax[axis];
+        header.sphereCenter[axis] = data.sphereCenter[axis];
+    }
+    header.sphereRadius = data.sphereRadius;
+
+    header.vertexOffset = alignOffset(sizeof(MeshCacheHeader));
+    header.indexOffset = alignOffset(header.vertexOffset + (uint64_t)header.vertexCount * sizeof(Vertex));
+    header.batchOffset = alignOffset(header.indexOffset + (uint64_t)header.indexCount * sizeof(uint32_t));
+    header.materialOffset = alignOffset(header.batchOffset + batches.size() * sizeof(CachedBatch));
+    header.nodeOffset = alignOffset(header.materialOffset + materials.size() * sizeof(CachedMaterial));
+    header.nodeMeshOffset = alignOffset(header.nodeOffset + nodes.size() * sizeof(CachedNode));
+    header.stringOffset = alignOffset(header.nodeMeshOffset + nodeMeshes.size() * sizeof(uint32_t));
+    header.fileSize = header.stringOffset + strings.size();
+
+    // 临时文件名带进程号与线程号，多个进程（或线程）同时生成同一个缓存时不会互相覆盖
+    std::string tempPath = cachePath + "." + std::to_string((long long)getpid()) + "." +
+                           std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    bool written = false;
+    {
+        std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        uint64_t position = 0;
+        auto writeSection = [&](uint64_t offset, const void* bytes, size_t size) {
+            static const char padding[8] = {};
+            file.write(padding, (std::streamsize)(offset - position));
+            file.write((const char*)bytes, (std::streamsize)size);
+            position = offset + size;
+        };
+        writeSection(0, &header, sizeof(header));
+        writeSection(header.vertexOffset, data.vertexData(), header.vertexCount * sizeof(Vertex));
+        writeSection(header.indexOffset, data.indexData(), header.indexCount * sizeof(uint32_t));
+        writeSection(header.batchOffset, batches.data(), batches.size() * sizeof(CachedBatch));
+        writeSection(header.materialOffset, materials.data(), materials.size() * sizeof(CachedMaterial));
+        writeSection(header.nodeOffset, nodes.data(), nodes.size() * sizeof(CachedNode));
+        writeSection(header.nodeMeshOffset, nodeMeshes.data(), nodeMeshes.size() * sizeof(uint32_t));
+        writeSection(header.stringOffset, strings.data(), strings.size());
+        written = (bool)file;
+    }
+
+    if (!written) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    std::remove(cachePath.c_str()); // Windows 上 rename 不会覆盖已有文件
+    if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
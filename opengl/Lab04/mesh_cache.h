@@ -0,0 +1,23 @@
+﻿#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include <string>
+#include <cstdint>
+#include "mesh.h"
+
+// 二进制网格缓存（<模型文件>.meshcache）：导入器输出的交错顶点、索引、包围盒、批次、
+// 材质贴图路径和节点层级。文件按本机字节序写出，可直接内存映射后上传
+//
+// importModel 的输出发生变化（顶点格式、优化步骤等）时递增版本号，旧缓存会自动失效
+const uint32_t MESH_CACHE_VERSION = 2;
+
+// 源文件内容与加载器版本的 FNV-1a 64 位哈希，文件不存在时返回 0
+uint64_t hashModelSource(const std::string& path);
+
+// 缓存存在、版本与哈希都匹配时映射文件并填充 data（顶点与索引直接指向映射内存）
+bool readMeshCache(const std::string& cachePath, uint64_t sourceHash, ModelData& data);
+
+// 写出缓存（先写临时文件再替换，中途失败不会留下损坏的缓存）
+bool writeMeshCache(const std::string& cachePath, uint64_t sourceHash, const ModelData& data);
+
+#endif
@@ -0,0 +1,486 @@
+﻿#include "postprocess.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+PostProcess postProcess;
+
+static const int kComputeTile = 16;
+
+static const char* passNames[POST_PASS_COUNT] = { "sobel", "thicken", "blur", "composite" };
+static const char* modeNames[POST_MODE_COUNT] = { "naive 2D passes", "separable passes", "compute shaders" };
+
+const char* postProcessModeName(PostProcessMode mode) {
+    return mode < POST_MODE_COUNT ? modeNames[mode] : "";
+}
+
+// 全屏三角形，无需顶点缓冲
+static const char* fullscreenVertexShader = R"(
+#version 330 core
+void main() {
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// G-buffer 取样与描边强度，片段与计算版本共用
+static const char* geometrySampling = R"(
+uniform sampler2D normalBuffer;
+uniform sampler2D depthBuffer;
+
+// 非线性深度还原为到相机的距离（坐标夹在纹理范围内）
+float linearDepthAt(ivec2 coord) {
+    coord = clamp(coord, ivec2(0), textureSize(depthBuffer, 0) - 1);
+    float ndc = texelFetch(depthBuffer, coord, 0).r * 2.0 - 1.0;
+    return projection[3][2] / (ndc + projection[2][2]);
+}
+
+// 法线 xyz 与距离 w
+vec4 sampleGeometry(ivec2 coord) {
+    vec3 normal = texelFetch(normalBuffer, clamp(coord, ivec2(0), textureSize(normalBuffer, 0) - 1), 0).xyz * 2.0 - 1.0;
+    return vec4(normal, linearDepthAt(coord));
+}
+
+// 深度按相对变化检测剪影与遮挡边，法线检测折痕
+float edgeStrength(vec4 gradientX, vec4 gradientY, float centerDepth) {
+    float depthEdge = length(vec2(gradientX.w, gradientY.w)) / centerDepth;
+    float normalEdge = sqrt(dot(gradientX.xyz, gradientX.xyz) + dot(gradientY.xyz, gradientY.xyz));
+    return max(smoothstep(0.1, 0.3, depthEdge), smoothstep(0.8, 1.6, normalEdge));
+}
+)";
+
+// 参考实现：一个通道直接做 3x3 Sobel，每像素 9 次取样
+static const char* sobelNaiveShader = R"(
+out vec4 edgeOut;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec4 taps[9];
+    for (int i = 0; i < 9; i++)
+        taps[i] = sampleGeometry(coord + ivec2(i % 3 - 1, i / 3 - 1));
+    vec4 gradientX = taps[2] + 2.0 * taps[5] + taps[8] - taps[0] - 2.0 * taps[3] - taps[6];
+    vec4 gradientY = taps[6] + 2.0 * taps[7] + taps[8] - taps[0] - 2.0 * taps[1] - taps[2];
+    edgeOut = vec4(edgeStrength(gradientX, gradientY, taps[4].w));
+}
+)";
+
+// Sobel = [1 2 1] 平滑 x [-1 0 1] 差分。横向通道同时输出两者，纵向通道再组合出两个方向的梯度
+static const char* sobelHorizontalShader = R"(
+layout(location = 0) out vec4 diffOut;
+layout(location = 1) out vec4 smoothOut;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec4 left = sampleGeometry(coord - ivec2(1, 0));
+    vec4 center = sampleGeometry(coord);
+    vec4 right = sampleGeometry(coord + ivec2(1, 0));
+    diffOut = right - left;
+    smoothOut = left + 2.0 * center + right;
+}
+)";
+
+static const char* sobelVerticalShader = R"(
+uniform sampler2D sourceImage;  // 横向差分
+uniform sampler2D sobelSmooth;  // 横向平滑
+
+out vec4 edgeOut;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(sourceImage, 0) - 1;
+    ivec2 below = max(coord - ivec2(0, 1), ivec2(0));
+    ivec2 above = min(coord + ivec2(0, 1), last);
+
+    vec4 gradientX = texelFetch(sourceImage, below, 0) + 2.0 * texelFetch(sourceImage, coord, 0) + texelFetch(sourceImage, above, 0);
+    vec4 gradientY = texelFetch(sobelSmooth, above, 0) - texelFetch(sobelSmooth, below, 0);
+    edgeOut = vec4(edgeStrength(gradientX, gradientY, linearDepthAt(coord)));
+}
+)";
+
+// 一维滤波：DILATE 时取最大值（加粗），否则为 [1 4 6 4 1] / 16 的高斯
+static const char* filterFunctions = R"(
+#ifdef DILATE
+const int RADIUS = 1;
+#else
+const int RADIUS = 2;
+const float weights[3] = float[](0.375, 0.25, 0.0625);
+#endif
+
+float combine(float sum, float value, int offset) {
+#ifdef DILATE
+    return max(sum, value);
+#else
+    return sum + value * weights[abs(offset)];
+#endif
+}
+)";
+
+static const char* filterFragmentShader = R"(
+uniform sampler2D sourceImage;
+uniform ivec2 filterDirection;
+
+out vec4 edgeOut;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(sourceImage, 0) - 1;
+    float sum = 0.0;
+    for (int i = -RADIUS; i <= RADIUS; i++)
+        sum = combine(sum, texelFetch(sourceImage, clamp(coord + filterDirection * i, ivec2(0), last), 0).r, i);
+    edgeOut = vec4(sum);
+}
+)";
+
+// 参考实现：二维窗口一次取完（半径 RADIUS 的方形窗口）
+static const char* filterNaiveShader = R"(
+uniform sampler2D sourceImage;
+
+out vec4 edgeOut;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(sourceImage, 0) - 1;
+    float sum = 0.0;
+    for (int y = -RADIUS; y <= RADIUS; y++) {
+        float row = 0.0;
+        for (int x = -RADIUS; x <= RADIUS; x++)
+            row = combine(row, texelFetch(sourceImage, clamp(coord + ivec2(x, y), ivec2(0), last), 0).r, x);
+        sum = combine(sum, row, y);
+    }
+    edgeOut = vec4(sum);
+}
+)";
+
+// 默认输出黑白素描（色调 * (1 - 描边)），useAlbedo 时再乘以固有色
+static const char* compositeShader = R"(
+uniform sampler2D colorBuffer;  // rgb 固有色，a 素描色调
+uniform sampler2D sourceImage;  // 描边强度
+uniform bool useAlbedo;
+
+out vec4 fragColor;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec4 color = texelFetch(colorBuffer, coord, 0);
+    vec3 paper = useAlbedo ? color.rgb : vec3(1.0);
+    fragColor = vec4(paper * color.a * (1.0 - texelFetch(sourceImage, coord, 0).r), 1.0);
+}
+)";
+
+// 计算版本：图块加一圈边缘读入共享内存后直接做 3x3 Sobel
+static const char* sobelComputeShader = R"(
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(r16f, binding = 0) writeonly uniform image2D edgeImage;
+
+const int TILE = 16;
+const int SIZE = TILE + 2;
+shared vec4 tile[SIZE * SIZE];
+
+vec4 tileAt(ivec2 local, int x, int y) {
+    return tile[(local.y + y) * SIZE + local.x + x];
+}
+
+void main() {
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * TILE - 1;
+    for (int i = int(gl_LocalInvocationIndex); i < SIZE * SIZE; i += TILE * TILE)
+        tile[i] = sampleGeometry(origin + ivec2(i % SIZE, i / SIZE));
+    barrier();
+
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (coord.x >= imageSize(edgeImage).x || coord.y >= imageSize(edgeImage).y)
+        return;
+
+    ivec2 local = ivec2(gl_LocalInvocationID.xy) + 1;
+    vec4 gradientX = tileAt(local, 1, -1) + 2.0 * tileAt(local, 1, 0) + tileAt(local, 1, 1)
+                   - tileAt(local, -1, -1) - 2.0 * tileAt(local, -1, 0) - tileAt(local, -1, 1);
+    vec4 gradientY = tileAt(local, -1, 1) + 2.0 * tileAt(local, 0, 1) + tileAt(local, 1, 1)
+                   - tileAt(local, -1, -1) - 2.0 * tileAt(local, 0, -1) - tileAt(local, 1, -1);
+    imageStore(edgeImage, coord, vec4(edgeStrength(gradientX, gradientY, tileAt(local, 0, 0).w)));
+}
+)";
+
+// 计算版本的可分离滤波：图块读入共享内存，先横向滤波到 rows，再纵向输出
+static const char* filterComputeShader = R"(
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(r16f, binding = 0) writeonly uniform image2D edgeImage;
+uniform sampler2D sourceImage;
+
+const int TILE = 16;
+const int SIZE = TILE + 2 * RADIUS;
+shared float tile[SIZE * SIZE];
+shared float rows[SIZE * TILE];  // SIZE 行 x TILE 列
+
+void main() {
+    int invocation = int(gl_LocalInvocationIndex);
+    ivec2 last = textureSize(sourceImage, 0) - 1;
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * TILE - RADIUS;
+    for (int i = invocation; i < SIZE * SIZE; i += TILE * TILE)
+        tile[i] = texelFetch(sourceImage, clamp(origin + ivec2(i % SIZE, i / SIZE), ivec2(0), last), 0).r;
+    barrier();
+
+    for (int i = invocation; i < SIZE * TILE; i += TILE * TILE) {
+        int row = i / TILE, column = i % TILE + RADIUS;
+        float sum = 0.0;
+        for (int k = -RADIUS; k <= RADIUS; k++)
+            sum = combine(sum, tile[row * SIZE + column + k], k);
+        rows[i] = sum;
+    }
+    barrier();
+
+    ivec2 local = ivec2(gl_LocalInvocationID.xy);
+    float sum = 0.0;
+    for (int k = -RADIUS; k <= RADIUS; k++)
+        sum = combine(sum, rows[(local.y + RADIUS + k) * TILE + local.x], k);
+
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (coord.x < imageSize(edgeImage).x && coord.y < imageSize(edgeImage).y)
+        imageStore(edgeImage, coord, vec4(sum));
+}
+)";
+
+
+// 拼出完整着色器：版本行 + 可选宏 + 公共函数 + 主体
+static std::string shaderSource(const char* version, const char* defines, const char* common, const char* body) {
+    return std::string("#version ") + version + "\n" + defines + common + body;
+}
+
+bool PostProcess::init() {
+    std::string sobelH = shaderSource("330 core", "", geometrySampling, sobelHorizontalShader);
+    std::string sobelV = shaderSource("330 core", "", geometrySampling, sobelVerticalShader);
+    std::string dilate = shaderSource("330 core", "#define DILATE\n", filterFunctions, filterFragmentShader);
+    std::string blur = shaderSource("330 core", "", filterFunctions, filterFragmentShader);
+    std::string composite = shaderSource("330 core", "", "", compositeShader);
+    std::string sobelRef = shaderSource("330 core", "", geometrySampling, sobelNaiveShader);
+    std::string dilateRef = shaderSource("330 core", "#define DILATE\n", filterFunctions, filterNaiveShader);
+    std::string blurRef = shaderSource("330 core", "", filterFunctions, filterNaiveShader);
+
+    bool linked = linkProgram(sobelHorizontal, fullscreenVertexShader, sobelH.c_str());
+    linked = linkProgram(sobelVertical, fullscreenVertexShader, sobelV.c_str()) && linked;
+    linked = linkProgram(dilateProgram, fullscreenVertexShader, dilate.c_str()) && linked;
+    linked = linkProgram(blurProgram, fullscreenVertexShader, blur.c_str()) && linked;
+    linked = linkProgram(compositeProgram, fullscreenVertexShader, composite.c_str()) && linked;
+    linked = linkProgram(sobelNaive, fullscreenVertexShader, sobelRef.c_str()) && linked;
+    linked = linkProgram(dilateNaive, fullscreenVertexShader, dilateRef.c_str()) && linked;
+    linked = linkProgram(blurNaive, fullscreenVertexShader, blurRef.c_str()) && linked;
+
+    if (GLEW_VERSION_4_3) {
+        std::string sobelCS = shaderSource("430", "", geometrySampling, sobelComputeShader);
+        std::string dilateCS = shaderSource("430", "#define DILATE\n", filterFunctions, filterComputeShader);
+        std::string blurCS = shaderSource("430", "", filterFunctions, filterComputeShader);
+        computeAvailable = linkComputeProgram(sobelCompute, sobelCS.c_str()) &&
+                           linkComputeProgram(dilateCompute, dilateCS.c_str()) &&
+                           linkComputeProgram(blurCompute, blurCS.c_str());
+        if (!computeAvailable)
+            std::cerr << "Post-process compute shaders failed, using separable passes" << std::endl;
+    }
+
+    glGenVertexArrays(1, &emptyVAO);
+    glGenFramebuffers(1, &sobelFramebuffer);
+    glGenFramebuffers(2, edgeFramebuffers);
+    timer.init(POST_PASS_COUNT);
+    return linked;
+}
+
+static GLuint createFilterTarget(GLenum internalFormat, GLenum format, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+// 检查当前绑定的帧缓冲（R16F/RGBA16F 作为颜色附件在部分驱动上不受支持）
+static void checkFramebuffer(const char* name) {
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Post-process " << name << " framebuffer is incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+}
+
+void PostProcess::deleteTargets() {
+    GLuint textures[] = { sobelDiff, sobelSmooth, edgeTextures[0], edgeTextures[1] };
+    glDeleteTextures(4, textures);
+    sobelDiff = sobelSmooth = edgeTextures[0] = edgeTextures[1] = 0;
+}
+
+void PostProcess::createTargets(int width, int height) {
+    deleteTargets();
+    targetWidth = width;
+    targetHeight = height;
+
+    // 横向 Sobel 的中间结果（法线 xyz + 距离 w），描边强度在两张 R16F 之间来回
+    sobelDiff = createFilterTarget(GL_RGBA16F, GL_RGBA, width, height);
+    sobelSmooth = createFilterTarget(GL_RGBA16F, GL_RGBA, width, height);
+    for (int i = 0; i < 2; i++)
+        edgeTextures[i] = createFilterTarget(GL_R16F, GL_RED, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sobelFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sobelDiff, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, sobelSmooth, 0);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    checkFramebuffer("Sobel");
+
+    for (int i = 0; i < 2; i++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, edgeFramebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, edgeTextures[i], 0);
+        checkFramebuffer(i == 0 ? "edge 0" : "edge 1");
+    }
+}
+
+void PostProcess::filterPass(const ShaderProgram& program, int source, int destination, const glm::ivec2& direction, GlStateCache& state) {
+    glBindFramebuffer(GL_FRAMEBUFFER, edgeFramebuffers[destination]);
+    state.useProgram(program.id);
+    glUniform2i(program[U_FILTER_DIRECTION], direction.x, direction.y);
+    state.bindTexture(TEXTURE_UNIT_POST_SOURCE, GL_TEXTURE_2D, edgeTextures[source]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void PostProcess::runNaive(const GBuffer& gbuffer, GlStateCache& state) {
+    timer.begin(POST_PASS_SOBEL);
+    glBindFramebuffer(GL_FRAMEBUFFER, edgeFramebuffers[0]);
+    state.useProgram(sobelNaive.id);
+    state.bindTexture(TEXTURE_UNIT_GBUFFER_NORMAL, GL_TEXTURE_2D, gbuffer.normalTarget());
+    state.bindTexture(TEXTURE_UNIT_GBUFFER_DEPTH, GL_TEXTURE_2D, gbuffer.depthTarget());
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    timer.end();
+
+    timer.begin(POST_PASS_THICKEN);
+    glBindFramebuffer(GL_FRAMEBUFFER, edgeFramebuffers[1]);
+    state.useProgram(dilateNaive.id);
+    state.bindTexture(TEXTURE_UNIT_POST_SOURCE, GL_TEXTURE_2D, edgeTextures[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    timer.end();
+
+    timer.begin(POST_PASS_BLUR);
+    glBindFramebuffer(GL_FRAMEBUFFER, edgeFramebuffers[0]);
+    state.useProgram(blurNaive.id);
+    state.bindTexture(TEXTURE_UNIT_POST_SOURCE, GL_TEXTURE_2D, edgeTextures[1]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    timer.end();
+}
+
+void PostProcess::runSeparable(const GBuffer& gbuffer, GlStateCache& state) {
+    timer.begin(POST_PASS_SOBEL);
+    glBindFramebuffer(GL_FRAMEBUFFER, sobelFramebuffer);
+    state.useProgram(sobelHorizontal.id);
+    state.bindTexture(TEXTURE_UNIT_GBUFFER_NORMAL, GL_TEXTURE_2D, gbuffer.normalTarget());
+    state.bindTexture(TEXTURE_UNIT_GBUFFER_DEPTH, GL_TEXTURE_2D, gbuffer.depthTarget());
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, edgeFramebuffers[0]);
+    state.useProgram(sobelVertical.id);
+    state.bindTexture(TEXTURE_UNIT_POST_SOURCE, GL_TEXTURE_2D, sobelDiff);
+    state.bindTexture(TEXTURE_UNIT_POST_AUX, GL_TEXTURE_2D, sobelSmooth);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    timer.end();
+
+    timer.begin(POST_PASS_THICKEN);
+    filterPass(dilateProgram, 0, 1, glm::ivec2(1, 0), state);
+    filterPass(dilateProgram, 1, 0, glm::ivec2(0, 1), state);
+    timer.end();
+
+    timer.begin(POST_PASS_BLUR);
+    filterPass(blurProgram, 0, 1, glm::ivec2(1, 0), state);
+    filterPass(blurProgram, 1, 0, glm::ivec2(0, 1), state);
+    timer.end();
+}
+
+void PostProcess::dispatch(const ShaderProgram& program, GLuint source, int destination, GlStateCache& state) {
+    state.useProgram(program.id);
+    if (source)
+        state.bindTexture(TEXTURE_UNIT_POST_SOURCE, GL_TEXTURE_2D, source);
+    glBindImageTexture(0, edgeTextures[destination], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+    glDispatchCompute((targetWidth + kComputeTile - 1) / kComputeTile, (targetHeight + kComputeTile - 1) / kComputeTile, 1);
+    // 下一通道通过采样器读取这次写入的结果
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void PostProcess::runCompute(const GBuffer& gbuffer, GlStateCache& state) {
+    timer.begin(POST_PASS_SOBEL);
+    state.bindTexture(TEXTURE_UNIT_GBUFFER_NORMAL, GL_TEXTURE_2D, gbuffer.normalTarget());
+    state.bindTexture(TEXTURE_UNIT_GBUFFER_DEPTH, GL_TEXTURE_2D, gbuffer.depthTarget());
+    dispatch(sobelCompute, 0, 0, state);
+    timer.end();
+
+    timer.begin(POST_PASS_THICKEN);
+    dispatch(dilateCompute, edgeTextures[0], 1, state);
+    timer.end();
+
+    timer.begin(POST_PASS_BLUR);
+    dispatch(blurCompute, edgeTextures[1], 0, state);
+    timer.end();
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R16F);
+}
+
+void PostProcess::run(const GBuffer& gbuffer, GLuint target, PostProcessMode mode, GlStateCache& state) {
+    if (mode == POST_MODE_COMPUTE && !computeAvailable)
+        mode = POST_MODE_SEPARABLE;
+    if (gbuffer.width() != targetWidth || gbuffer.height() != targetHeight || !edgeTextures[0])
+        createTargets(gbuffer.width(), gbuffer.height());
+    if (mode != lastMode) {
+        // 各实现的耗时分开统计
+        timer.reset();
+        lastMode = mode;
+    }
+
+    glViewport(0, 0, targetWidth, targetHeight);
+    glDisable(GL_DEPTH_TEST);
+    state.bindVertexArray(emptyVAO);
+
+    if (mode == POST_MODE_COMPUTE)
+        runCompute(gbuffer, state);
+    else if (mode == POST_MODE_SEPARABLE)
+        runSeparable(gbuffer, state);
+    else
+        runNaive(gbuffer, state);
+
+    // 描边结果都在 edgeTextures[0]
+    timer.begin(POST_PASS_COMPOSITE);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    state.useProgram(compositeProgram.id);
+    state.setUniform1i(compositeProgram, U_USE_ALBEDO, albedoEnabled ? 1 : 0);
+    state.bindTexture(TEXTURE_UNIT_GBUFFER_COLOR, GL_TEXTURE_2D, gbuffer.colorTarget());
+    state.bindTexture(TEXTURE_UNIT_POST_SOURCE, GL_TEXTURE_2D, edgeTextures[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    timer.end();
+    timer.endFrame();
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void PostProcess::printTimings() {
+    if (!timer.isAvailable() || timer.sampleCount(POST_PASS_COMPOSITE) == 0)
+        return;
+    timer.flush();
+
+    double total = 0.0;
+    std::cout << "Post-process (" << postProcessModeName(lastMode) << ", "
+              << targetWidth << "x" << targetHeight << "):" << std::fixed << std::setprecision(3);
+    for (int pass = 0; pass < POST_PASS_COUNT; pass++) {
+        double milliseconds = timer.averageMilliseconds(pass);
+        total += milliseconds;
+        std::cout << " " << passNames[pass] << " " << milliseconds << " ms";
+    }
+    std::cout << ", total " << total << " ms" << std::defaultfloat << std::endl;
+}
+
+void PostProcess::release() {
+    deleteTargets();
+    GLuint framebuffers[] = { sobelFramebuffer, edgeFramebuffers[0], edgeFramebuffers[1] };
+    glDeleteFramebuffers(3, framebuffers);
+    glDeleteVertexArrays(1, &emptyVAO);
+    const ShaderProgram* programs[] = { &sobelHorizontal, &sobelVertical, &dilateProgram, &blurProgram, &compositeProgram,
+                                        &sobelNaive, &dilateNaive, &blurNaive, &sobelCompute, &dilateCompute, &blurCompute };
+    for (const ShaderProgram* program : programs)
+        glDeleteProgram(program->id);
+    timer.release();
+    sobelFramebuffer = edgeFramebuffers[0] = edgeFramebuffers[1] = emptyVAO = 0;
+    targetWidth = targetHeight = 0;
+    computeAvailable = false;
+    lastMode = POST_MODE_COUNT;
+}
@@ -0,0 +1,72 @@
+﻿#ifndef _POSTPROCESS_H_
+#define _POSTPROCESS_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "shader_program.h"
+#include "gl_state.h"
+#include "gbuffer.h"
+#include "gpu_timer.h"
+
+// 后处理各通道，分别计时
+enum PostProcessPass {
+    POST_PASS_SOBEL,        // G-buffer 深度/法线上的 Sobel 描边
+    POST_PASS_THICKEN,      // 线条加粗（最大值滤波）
+    POST_PASS_BLUR,         // 笔触柔化（5 阶高斯）
+    POST_PASS_COMPOSITE,    // 色调 * (1 - 描边) 写入输出（albedoEnabled 时再乘以固有色）
+    POST_PASS_COUNT
+};
+
+// 后处理的实现，输出相同
+enum PostProcessMode {
+    POST_MODE_NAIVE,        // 参考实现：每个滤波一个二维片段着色器通道（Sobel 9 次、加粗 9 次、高斯 25 次取样）
+    POST_MODE_SEPARABLE,    // 每个滤波拆成横、纵两个片段着色器通道，3x3 Sobel 每像素 9 次取样变为 3 + 3 次
+    POST_MODE_COMPUTE,      // 计算着色器（GL 4.3）：16x16 的工作组把图块连同边缘一圈读进共享内存，
+                            // 每个纹素只从显存取一次，滤波在共享内存中完成
+    POST_MODE_COUNT
+};
+
+// 屏幕空间描边后处理，各通道用 GpuTimer 计时，便于比较三种实现
+class PostProcess {
+public:
+    bool init();
+    bool hasCompute() const { return computeAvailable; }
+
+    // 合成时是否用 G-buffer 中的固有色给素描上色（默认黑白）
+    bool albedoEnabled = false;
+
+    // 计算着色器不可用时以可分离版本代替
+    void run(const GBuffer& gbuffer, GLuint target, PostProcessMode mode, GlStateCache& state);
+
+    // 输出每个通道的平均 GPU 耗时（会等待尚未返回的计时结果）
+    void printTimings();
+
+    void release();
+
+private:
+    ShaderProgram sobelHorizontal, sobelVertical, dilateProgram, blurProgram, compositeProgram;
+    ShaderProgram sobelNaive, dilateNaive, blurNaive;
+    ShaderProgram sobelCompute, dilateCompute, blurCompute;
+    bool computeAvailable = false;
+    PostProcessMode lastMode = POST_MODE_COUNT;
+
+    GLuint emptyVAO = 0;
+    GLuint sobelFramebuffer = 0, edgeFramebuffers[2] = {};
+    GLuint sobelDiff = 0, sobelSmooth = 0, edgeTextures[2] = {};
+    int targetWidth = 0, targetHeight = 0;
+    GpuTimer timer;
+
+    void createTargets(int width, int height);
+    void deleteTargets();
+    void runNaive(const GBuffer& gbuffer, GlStateCache& state);
+    void runSeparable(const GBuffer& gbuffer, GlStateCache& state);
+    void runCompute(const GBuffer& gbuffer, GlStateCache& state);
+    void filterPass(const ShaderProgram& program, int source, int destination, const glm::ivec2& direction, GlStateCache& state);
+    void dispatch(const ShaderProgram& program, GLuint source, int destination, GlStateCache& state);
+};
+
+extern PostProcess postProcess;
+
+const char* postProcessModeName(PostProcessMode mode);
+
+#endif
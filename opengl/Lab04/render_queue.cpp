@@ -0,0 +1,121 @@
+﻿#include "render_queue.h"
+#include <algorithm>
+
+RenderQueue renderQueue;
+
+static const int kDepthBits = 24;
+
+static uint64_t quantizeDepth(float depth) {
+    float clamped = std::min(std::max(depth, 0.0f), 1.0f);
+    return (uint64_t)(clamped * ((1u << kDepthBits) - 1));
+}
+
+uint64_t materialSortKey(RenderPass pass, GLuint program, GLuint texture, GLuint vao, float depth) {
+    return ((uint64_t)pass << 60) | ((uint64_t)(program & 0xff) << 52) | ((uint64_t)(texture & 0xffff) << 36) |
+           ((uint64_t)(vao & 0xfff) << 24) | quantizeDepth(depth);
+}
+
+uint64_t depthSortKey(RenderPass pass, float depth, GLuint program, GLuint vao) {
+    return ((uint64_t)pass << 60) | (quantizeDepth(depth) << 36) | ((uint64_t)(program & 0xff) << 28) |
+           ((uint64_t)(vao & 0xfff) << 16);
+}
+
+void radixSortKeys(std::vector<uint64_t>& keys, std::vector<uint32_t>& order,
+                   std::vector<uint64_t>& keysScratch, std::vector<uint32_t>& orderScratch) {
+    size_t count = keys.size();
+    keysScratch.resize(count);
+    orderScratch.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t histogram[256] = {};
+        for (size_t i = 0; i < count; i++)
+            histogram[(keys[i] >> shift) & 0xff]++;
+        if (count == 0 || histogram[(keys[0] >> shift) & 0xff] == count)
+            continue; // 这一字节全部相同，顺序不变
+
+        size_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t bucket = histogram[b];
+            histogram[b] = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t destination = histogram[(keys[i] >> shift) & 0xff]++;
+            keysScratch[destination] = keys[i];
+            orderScratch[destination] = order[i];
+        }
+        keys.swap(keysScratch);
+        order.swap(orderScratch);
+    }
+}
+
+void RenderQueue::sort() {
+    keys.resize(items.size());
+    order.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        keys[i] = items[i].key;
+        order[i] = (uint32_t)i;
+    }
+    radixSortKeys(keys, order, keysScratch, orderScratch);
+}
+
+void RenderQueue::submit(GlStateCache& state) {
+    sort();
+
+    // 队列之外的代码（遮挡体预渲染、纹理流式上传等）会直接修改绑定
+    state.invalidate();
+    int currentPass = -1;
+
+    for (uint32_t index : order) {
+        const RenderItem& item = items[index];
+        int pass = (int)(item.key >> 60);
+        if (pass != currentPass && pass < RENDER_PASS_COUNT) {
+            const PassState& passState = passStates[pass];
+            state.setColorMask(passState.colorWrite);
+            state.setDepthMask(passState.depthWrite);
+            state.setDepthFunc(passState.depthFunc);
+            currentPass = pass;
+        }
+
+        if (item.program) {
+            const ShaderProgram& program = *item.program;
+            state.useProgram(program.id);
+            if (item.material) {
+                state.setUniform1i(program, U_USE_TEXTURE, item.texture ? 1 : 0);
+                if (item.texture)
+                    state.bindTexture(TEXTURE_UNIT_DIFFUSE, item.textureTarget, item.texture);
+                if (item.normalMap)
+                    state.bindTexture(TEXTURE_UNIT_NORMAL_MAP, GL_TEXTURE_2D, item.normalMap);
+            }
+            state.setUniform1i(program, U_USE_INSTANCING, item.instanced ? 1 : 0);
+            if (!item.instanced)
+                state.setUniformMatrix4(program, U_MODEL, item.model);
+        }
+
+        if (item.custom) {
+            // 自定义绘制（间接绘制、地形）直接修改绑定，部分还会写自己程序的 uniform
+            item.custom();
+            state.invalidate();
+            if (item.customUniforms)
+                state.invalidateUniforms(item.customUniforms);
+            continue;
+        }
+
+        state.bindVertexArray(item.vao);
+        if (item.primitiveRestart) {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(item.indexType == GL_UNSIGNED_SHORT ? 0xffffu : 0xffffffffu);
+        }
+        if (item.indexType)
+            glDrawElementsInstanced(item.mode, item.count, item.indexType, (void*)item.indexOffset, item.instanceCount);
+        else
+            glDrawArraysInstanced(item.mode, 0, item.count, item.instanceCount);
+        if (item.primitiveRestart)
+            glDisable(GL_PRIMITIVE_RESTART);
+    }
+
+    state.bindVertexArray(0);
+    state.setColorMask(true);
+    state.setDepthMask(true);
+    state.setDepthFunc(GL_LESS);
+}
@@ -0,0 +1,85 @@
+﻿#ifndef _RENDER_QUEUE_H_
+#define _RENDER_QUEUE_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "shader_program.h"
+#include "gl_state.h"
+
+// 渲染通道，按顺序提交（排序键的最高 4 位）
+enum RenderPass {
+    PASS_DEPTH = 0,     // 深度预渲染
+    PASS_OPAQUE = 1,    // 不透明物体着色
+    PASS_SKY = 2,       // 天空盒
+    RENDER_PASS_COUNT
+};
+
+// 通道开始时设置的固定状态
+struct PassState {
+    bool colorWrite = true;
+    bool depthWrite = true;
+    GLenum depthFunc = GL_LESS;
+};
+
+// 一个绘制项：状态（程序、材质、VAO、uniform）加一次绘制调用
+struct RenderItem {
+    uint64_t key = 0;
+    const ShaderProgram* program = nullptr; // 为空时只调用 custom，由其自行管理状态
+    GLuint vao = 0;
+
+    bool material = false;                  // 是否设置贴图与 useTexture（深度通道不需要）
+    GLenum textureTarget = GL_TEXTURE_2D;
+    GLuint texture = 0;
+    GLuint normalMap = 0;
+
+    bool instanced = false;                 // false 时设置 model uniform
+    glm::mat4 model = glm::mat4(1.0f);
+
+    GLenum mode = GL_TRIANGLES;
+    GLenum indexType = 0;                   // 0 表示非索引绘制
+    GLsizei count = 0;
+    size_t indexOffset = 0;                 // 字节偏移
+    GLsizei instanceCount = 1;
+    bool primitiveRestart = false;
+
+    std::function<void()> custom;           // 非空时代替上面的绘制调用（地形、间接绘制等）
+    GLuint customUniforms = 0;              // custom 绕过缓存直接写 uniform 的程序，执行后只清除它的缓存
+};
+
+// 排序键，高位优先比较。
+// 材质优先：pass 4 | program 8 | texture 16 | VAO 12 | depth 24，相同材质内由近到远
+uint64_t materialSortKey(RenderPass pass, GLuint program, GLuint texture, GLuint vao, float depth);
+// 深度优先：pass 4 | depth 24 | program 8 | VAO 12，用于深度预渲染（只求尽早剔除）
+uint64_t depthSortKey(RenderPass pass, float depth, GLuint program, GLuint vao);
+
+// 收集一帧的绘制项，按键做基数排序后通过状态缓存提交
+class RenderQueue {
+public:
+    void clear() { items.clear(); }
+    RenderItem& add() { items.push_back(RenderItem()); return items.back(); }
+    size_t size() const { return items.size(); }
+
+    void setPassState(RenderPass pass, const PassState& state) { passStates[pass] = state; }
+
+    // 排序并提交；结束时恢复默认深度/颜色写入
+    void submit(GlStateCache& state);
+
+private:
+    std::vector<RenderItem> items;
+    PassState passStates[RENDER_PASS_COUNT];
+    std::vector<uint64_t> keys, keysScratch;
+    std::vector<uint32_t> order, orderScratch;
+
+    void sort();
+};
+
+// 对 keys 做 LSD 基数排序（每次 8 位，所有键该字节相同的轮次跳过），order 随之重排
+void radixSortKeys(std::vector<uint64_t>& keys, std::vector<uint32_t>& order,
+                   std::vector<uint64_t>& keysScratch, std::vector<uint32_t>& orderScratch);
+
+extern RenderQueue renderQueue;
+
+#endif
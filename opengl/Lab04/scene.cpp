@@ -0,0 +1,267 @@
+﻿#include "scene.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+static const uint32_t kInvalidIndex = 0xffffffffu;
+// 对象数不少于此值时视锥剔除改为遍历 BVH；更少时逐个 SIMD 测试更快
+static const size_t kBvhCullThreshold = 64;
+
+
+MeshHandle Scene::addMesh(ModelData&& mesh, const std::string& key) {
+    if (mesh.pointCount > 0)
+        uploadMesh(mesh);
+    meshes.push_back(std::move(mesh));
+
+    MeshHandle handle = (MeshHandle)(meshes.size() - 1);
+    if (!key.empty())
+        meshByKey[key] = handle;
+    return handle;
+}
+
+MeshHandle Scene::findMesh(const std::string& key) const {
+    std::unordered_map<std::string, MeshHandle>::const_iterator it = meshByKey.find(key);
+    return it == meshByKey.end() ? INVALID_MESH : it->second;
+}
+
+void Scene::reserve(size_t objectCapacity) {
+    positions.reserve(objectCapacity);
+    rotations.reserve(objectCapacity);
+    meshIds.reserve(objectCapacity);
+    flags.reserve(objectCapacity);
+    modelMatrices.reserve(objectCapacity);
+    denseToSlot.reserve(objectCapacity);
+    slotToDense.reserve(objectCapacity);
+    slotGeneration.reserve(objectCapacity);
+}
+
+ObjectHandle Scene::addObject(MeshHandle mesh, const glm::vec3& position, const glm::mat4& rotation, uint32_t objectFlags) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = (uint32_t)slotToDense.size();
+        slotToDense.push_back(kInvalidIndex);
+        slotGeneration.push_back(0);
+    }
+
+    uint32_t dense = (uint32_t)positions.size();
+    slotToDense[slot] = dense;
+    denseToSlot.push_back(slot);
+
+    positions.push_back(position);
+    rotations.push_back(glm::mat3(rotation));
+    meshIds.push_back(mesh);
+    flags.push_back(objectFlags);
+    modelMatrices.push_back(glm::mat4(1.0f));
+    bvhDirty = true;
+
+    ObjectHandle handle;
+    handle.slot = slot;
+    handle.generation = slotGeneration[slot];
+    return handle;
+}
+
+void Scene::removeObject(ObjectHandle handle) {
+    uint32_t dense = denseIndex(handle);
+    if (dense == kInvalidIndex)
+        return;
+
+    // 用最后一个对象填补被删除的位置，保持数组紧凑
+    uint32_t last = (uint32_t)positions.size() - 1;
+    if (dense != last) {
+        positions[dense] = positions[last];
+        rotations[dense] = rotations[last];
+        meshIds[dense] = meshIds[last];
+        flags[dense] = flags[last];
+        modelMatrices[dense] = modelMatrices[last];
+        denseToSlot[dense] = denseToSlot[last];
+        slotToDense[denseToSlot[dense]] = dense;
+    }
+
+    positions.pop_back();
+    rotations.pop_back();
+    meshIds.pop_back();
+    flags.pop_back();
+    modelMatrices.pop_back();
+    denseToSlot.pop_back();
+
+    slotToDense[handle.slot] = kInvalidIndex;
+    slotGeneration[handle.slot]++;
+    freeSlots.push_back(handle.slot);
+    bvhDirty = true;
+}
+
+bool Scene::isAlive(ObjectHandle handle) const {
+    return denseIndex(handle) != kInvalidIndex;
+}
+
+uint32_t Scene::denseIndex(ObjectHandle handle) const {
+    if (handle.slot >= slotToDense.size() || slotGeneration[handle.slot] != handle.generation)
+        return kInvalidIndex;
+    return slotToDense[handle.slot];
+}
+
+void Scene::setPosition(ObjectHandle handle, const glm::vec3& position) {
+    uint32_t dense = denseIndex(handle);
+    if (dense != kInvalidIndex)
+        positions[dense] = position;
+}
+
+void Scene::setRotation(ObjectHandle handle, const glm::mat4& rotation) {
+    uint32_t dense = denseIndex(handle);
+    if (dense != kInvalidIndex)
+        rotations[dense] = glm::mat3(rotation);
+}
+
+void Scene::updateTransforms(const glm::mat4& shared, const glm::mat4& sharedPropeller) {
+    size_t count = positions.size();
+    const glm::vec3* position = positions.data();
+    const glm::mat3* rotation = rotations.data();
+    const uint32_t* flag = flags.data();
+    glm::mat4* model = modelMatrices.data();
+
+    sphereX.resize(count);
+    sphereY.resize(count);
+    sphereZ.resize(count);
+    sphereRadius.resize(count);
+
+    // shared 与 rotation 都是纯旋转：只需 3x3 乘法，平移列直接写入位置
+    for (size_t i = 0; i < count; i++) {
+        const glm::mat4& s = (flag[i] & OBJECT_PROPELLER) ? sharedPropeller : shared;
+        const glm::mat3& r = rotation[i];
+        for (int c = 0; c < 3; c++) {
+            glm::vec3 column = r[0] * s[c][0] + r[1] * s[c][1] + r[2] * s[c][2];
+            model[i][c] = glm::vec4(column, 0.0f);
+        }
+        model[i][3] = glm::vec4(position[i], 1.0f);
+
+        // 纯旋转不改变半径，只需变换球心
+        const ModelData& mesh = meshes[meshIds[i]];
+        glm::vec4 center = model[i] * glm::vec4(mesh.sphereCenter, 1.0f);
+        sphereX[i] = center.x;
+        sphereY[i] = center.y;
+        sphereZ[i] = center.z;
+        sphereRadius[i] = mesh.sphereRadius;
+    }
+
+    // 对象集合变化后下标全变了，只能重建；否则 refit，树质量退化太多时再重建
+    if (bvhDirty || bvh.primitiveCount() != count ||
+        !bvh.refit(sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data())) {
+        bvh.build(sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data(), count);
+        bvhDirty = false;
+    }
+}
+
+void Scene::cullObjects(const Frustum& frustum) {
+    size_t count = sphereX.size();
+    visible.resize(count);
+    if (count >= kBvhCullThreshold && bvh.primitiveCount() == count)
+        visibleCount = bvh.queryFrustum(frustum, visible.data());
+    else
+        visibleCount = cullSpheres(frustum, sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data(), count, visible.data());
+}
+
+ObjectHandle Scene::handleAt(size_t dense) const {
+    ObjectHandle handle;
+    if (dense < denseToSlot.size()) {
+        handle.slot = denseToSlot[dense];
+        handle.generation = slotGeneration[handle.slot];
+    }
+    return handle;
+}
+
+ObjectHandle Scene::pickObject(const glm::vec3& origin, const glm::vec3& direction, float* distance) const {
+    float hitT = FLT_MAX;
+    int hit = bvh.primitiveCount() == positions.size() ? bvh.raycast(origin, direction, hitT) : -1;
+    if (distance)
+        *distance = hitT;
+    return hit < 0 ? ObjectHandle() : handleAt(hit);
+}
+
+void Scene::queryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& result) const {
+    if (bvh.primitiveCount() == positions.size()) {
+        bvh.queryBox(boundsMin, boundsMax, result);
+        return;
+    }
+
+    // BVH 尚未建立（updateTransforms 之前）时逐个测试
+    result.clear();
+    for (size_t i = 0; i < sphereX.size(); i++) {
+        glm::vec3 center(sphereX[i], sphereY[i], sphereZ[i]);
+        glm::vec3 offset = center - glm::clamp(center, boundsMin, boundsMax);
+        if (glm::dot(offset, offset) <= sphereRadius[i] * sphereRadius[i])
+            result.push_back((uint32_t)i);
+    }
+}
+
+void Scene::buildInstanceBatches(const glm::vec3* sortOrigin) {
+    size_t objects = positions.size();
+    bool culled = visible.size() == objects; // 本帧未做剔除时全部绘制
+    size_t count = culled ? visibleCount : objects;
+
+    // 计数排序：先统计每个网格的可见对象数，再确定每组在实例缓冲中的起点
+    std::vector<uint32_t> groupStart(meshes.size() + 1, 0);
+    for (size_t i = 0; i < objects; i++) {
+        if (!culled || visible[i])
+            groupStart[meshIds[i] + 1]++;
+    }
+    for (size_t m = 0; m < meshes.size(); m++)
+        groupStart[m + 1] += groupStart[m];
+
+    std::vector<uint32_t> order(count);
+    std::vector<uint32_t> cursor(groupStart.begin(), groupStart.end() - 1);
+    for (size_t i = 0; i < objects; i++) {
+        if (!culled || visible[i])
+            order[cursor[meshIds[i]]++] = (uint32_t)i;
+    }
+
+    std::vector<float> distance;
+    if (sortOrigin) {
+        distance.resize(objects);
+        for (uint32_t i : order) {
+            glm::vec3 offset = glm::vec3(sphereX[i], sphereY[i], sphereZ[i]) - *sortOrigin;
+            distance[i] = glm::dot(offset, offset);
+        }
+        for (size_t m = 0; m < meshes.size(); m++) {
+            std::sort(order.begin() + groupStart[m], order.begin() + groupStart[m + 1],
+                      [&distance](uint32_t a, uint32_t b) { return distance[a] < distance[b]; });
+        }
+    }
+
+    instanceBatches.clear();
+    for (size_t m = 0; m < meshes.size(); m++) {
+        uint32_t instances = groupStart[m + 1] - groupStart[m];
+        if (instances == 0 || !meshes[m].vao)
+            continue;
+        InstanceBatch batch;
+        batch.mesh = (MeshHandle)m;
+        batch.firstInstance = groupStart[m];
+        batch.instanceCount = instances;
+        batch.distance = sortOrigin ? std::sqrt(distance[order[groupStart[m]]]) : 0.0f;
+        instanceBatches.push_back(batch);
+    }
+    if (sortOrigin) {
+        // 组内已排好序，首个实例即该批次最近的对象
+        std::sort(instanceBatches.begin(), instanceBatches.end(), [&](const InstanceBatch& a, const InstanceBatch& b) {
+            return distance[order[a.firstInstance]] < distance[order[b.firstInstance]];
+        });
+    }
+
+    instanceData.resize(count);
+    for (size_t k = 0; k < count; k++)
+        instanceData[k] = modelMatrices[order[k]];
+
+    if (!instanceBuffer)
+        glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    if (count > instanceCapacity)
+        instanceCapacity = count * 2;
+    // 每帧重新分配（orphan），避免等待上一帧仍在使用的缓冲
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    if (count > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), instanceData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,110 @@
+﻿#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include "mesh.h"
+#include "culling.h"
+#include "bvh.h"
+
+typedef uint32_t MeshHandle;
+const MeshHandle INVALID_MESH = 0xffffffffu;
+
+// 对象句柄：slot 指向稀疏表，generation 用于识别已删除对象的过期句柄
+struct ObjectHandle {
+    uint32_t slot = 0xffffffffu;
+    uint32_t generation = 0;
+};
+
+// 对象标志
+enum ObjectFlags {
+    OBJECT_PROPELLER = 1 << 0,   // 额外应用螺旋桨旋转
+    OBJECT_OCCLUDER = 1 << 1,    // 大型遮挡体（建筑立面等），绘制进层次 Z 的深度预渲染
+};
+
+// 共享同一网格的一组对象，用一次实例化绘制完成
+struct InstanceBatch {
+    MeshHandle mesh;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    float distance;         // 最近实例的包围球心到排序原点的距离（未排序时为 0）
+};
+
+// 场景容器：网格库 + 按结构数组（SoA）存放的对象。
+// 存活对象始终紧凑地排在 [0, objectCount()) 中，删除时用末尾对象填补空位。
+class Scene {
+public:
+    std::vector<ModelData> meshes;
+
+    // 密集数组（下标为 dense index）
+    std::vector<glm::vec3> positions;
+    std::vector<glm::mat3> rotations;
+    std::vector<MeshHandle> meshIds;
+    std::vector<uint32_t> flags;
+    std::vector<glm::mat4> modelMatrices; // updateTransforms 的输出
+
+    // 世界空间包围球（SoA，updateTransforms 的输出）与视锥剔除结果
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    std::vector<uint8_t> visible;
+    size_t visibleCount = 0;
+
+    // 包围球上的 BVH（updateTransforms 末尾维护）：增删对象后重建，只有移动时 refit
+    Bvh bvh;
+
+    // 实例化绘制数据（buildInstanceBatches 生成）
+    std::vector<InstanceBatch> instanceBatches;
+    GLuint instanceBuffer = 0;
+
+    // 上传网格并加入网格库；key 非空时可用 findMesh 复用同一网格
+    MeshHandle addMesh(ModelData&& mesh, const std::string& key = std::string());
+    MeshHandle findMesh(const std::string& key) const;
+
+    ObjectHandle addObject(MeshHandle mesh, const glm::vec3& position, const glm::mat4& rotation, uint32_t objectFlags = 0);
+    void removeObject(ObjectHandle handle);
+    bool isAlive(ObjectHandle handle) const;
+
+    void setPosition(ObjectHandle handle, const glm::vec3& position);
+    void setRotation(ObjectHandle handle, const glm::mat4& rotation);
+
+    size_t objectCount() const { return positions.size(); }
+    void reserve(size_t objectCapacity);
+
+    // 一次遍历计算所有对象的模型矩阵：model = T(position) * rotation * shared，
+    // 带 OBJECT_PROPELLER 标志的对象使用 sharedPropeller
+    void updateTransforms(const glm::mat4& shared, const glm::mat4& sharedPropeller);
+
+    // 用 updateTransforms 算出的包围球做视锥剔除，结果供 buildInstanceBatches 使用。
+    // 对象较多时遍历 BVH，较少时直接用 SIMD 逐个测试
+    void cullObjects(const Frustum& frustum);
+
+    // 拾取：射线最先命中的对象包围球，没有命中返回无效句柄且 distance 为 FLT_MAX；distance 以 direction 长度为单位
+    ObjectHandle pickObject(const glm::vec3& origin, const glm::vec3& direction, float* distance = nullptr) const;
+
+    // 包围球与包围盒重叠的对象（密集下标），用于挑选遮挡体
+    void queryBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& result) const;
+
+    // 密集下标对应的句柄
+    ObjectHandle handleAt(size_t dense) const;
+
+    // 按网格把可见对象分组（计数排序），模型矩阵按组连续写入实例缓冲。
+    // 给出 sortOrigin 时组内按包围球距离由近到远排列，批次按各自最近的对象排序（利于提前深度测试）
+    void buildInstanceBatches(const glm::vec3* sortOrigin = nullptr);
+
+private:
+    std::vector<uint32_t> denseToSlot;
+    std::vector<uint32_t> slotToDense;
+    std::vector<uint32_t> slotGeneration;
+    std::vector<uint32_t> freeSlots;
+
+    std::unordered_map<std::string, MeshHandle> meshByKey;
+    std::vector<glm::mat4> instanceData;
+    size_t instanceCapacity = 0;
+    bool bvhDirty = true;
+
+    uint32_t denseIndex(ObjectHandle handle) const;
+};
+
+#endif
@@ -0,0 +1,164 @@
+﻿#include "shader_program.h"
+#include <iostream>
+#include <string>
+
+static const char* uniformNames[UNIFORM_SLOT_COUNT] = {
+    "model",
+    "useTexture",
+    "defaultColor",
+    "textureSampler",
+    "strokeTexture",
+    "normalMap",
+    "bumpMappingEnabled",
+    "useInstancing",
+    "skybox",
+    "frustumPlanes",
+    "objectCount",
+    "hiZ",
+    "previousSize",
+    "hiZEnabled",
+    "hiZSize",
+    "hiZLevels",
+    "colorBuffer",
+    "normalBuffer",
+    "depthBuffer",
+    "sourceImage",
+    "sobelSmooth",
+    "filterDirection",
+    "useAlbedo",
+};
+
+const char* frameUniformBlockSource = R"(
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPosition;
+    vec4 lightDir;
+};
+)";
+
+static GLuint frameUBO = 0;
+
+
+// 把 FrameData 声明插入到 #version 行之后
+static std::string injectFrameBlock(const char* source) {
+    std::string text = source;
+    size_t version = text.find("#version");
+    size_t lineEnd = version == std::string::npos ? 0 : text.find('\n', version) + 1;
+    text.insert(lineEnd, frameUniformBlockSource);
+    return text;
+}
+
+// 采样器只需设置一次（程序中不存在的 uniform 位置为 -1，会被忽略）
+static void setSamplerUnits(const ShaderProgram& program) {
+    glUseProgram(program.id);
+    glUniform1i(program[U_TEXTURE_SAMPLER], TEXTURE_UNIT_DIFFUSE);
+    glUniform1i(program[U_SKYBOX], TEXTURE_UNIT_DIFFUSE);
+    glUniform1i(program[U_STROKE_TEXTURE], TEXTURE_UNIT_STROKE);
+    glUniform1i(program[U_NORMAL_MAP], TEXTURE_UNIT_NORMAL_MAP);
+    glUniform1i(program[U_HIZ_TEXTURE], TEXTURE_UNIT_HIZ);
+    glUniform1i(program[U_GBUFFER_COLOR], TEXTURE_UNIT_GBUFFER_COLOR);
+    glUniform1i(program[U_GBUFFER_NORMAL], TEXTURE_UNIT_GBUFFER_NORMAL);
+    glUniform1i(program[U_GBUFFER_DEPTH], TEXTURE_UNIT_GBUFFER_DEPTH);
+    glUniform1i(program[U_SOURCE_IMAGE], TEXTURE_UNIT_POST_SOURCE);
+    glUniform1i(program[U_SOBEL_SMOOTH], TEXTURE_UNIT_POST_AUX);
+    glUseProgram(0);
+}
+
+// 编译单个着色器
+GLuint compileShader(GLenum shaderType, const char* shaderSource) {
+    GLuint shader = glCreateShader(shaderType);
+    glShaderSource(shader, 1, &shaderSource, nullptr);
+    glCompileShader(shader);
+
+    // 检查编译错误
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetShaderInfoLog(shader, 512, nullptr, log);
+        std::cerr << "Shader compilation error: " << log << std::endl;
+    }
+
+    return shader;
+}
+
+bool linkProgram(ShaderProgram& program, const char* vertexSource, const char* fragmentSource) {
+    std::string vs = injectFrameBlock(vertexSource);
+    std::string fs = injectFrameBlock(fragmentSource);
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vs.c_str());
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fs.c_str());
+
+    program.id = glCreateProgram();
+    glAttachShader(program.id, vertexShader);
+    glAttachShader(program.id, fragmentShader);
+    glLinkProgram(program.id);
+
+    // 检查链接错误
+    GLint success;
+    glGetProgramiv(program.id, GL_LINK_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetProgramInfoLog(program.id, 512, nullptr, log);
+        std::cerr << "Shader program linking error: " << log << std::endl;
+    }
+
+    // 删除着色器对象
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    // 缓存 uniform 位置（着色器中不存在的为 -1，glUniform* 会忽略）
+    for (int i = 0; i < UNIFORM_SLOT_COUNT; i++)
+        program.uniforms[i] = glGetUniformLocation(program.id, uniformNames[i]);
+
+    GLuint blockIndex = glGetUniformBlockIndex(program.id, "FrameData");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program.id, blockIndex, FRAME_UNIFORM_BINDING);
+
+    setSamplerUnits(program);
+    return success == GL_TRUE;
+}
+
+bool linkComputeProgram(ShaderProgram& program, const char* computeSource) {
+    std::string cs = injectFrameBlock(computeSource);
+    GLuint computeShader = compileShader(GL_COMPUTE_SHADER, cs.c_str());
+
+    program.id = glCreateProgram();
+    glAttachShader(program.id, computeShader);
+    glLinkProgram(program.id);
+
+    GLint success;
+    glGetProgramiv(program.id, GL_LINK_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetProgramInfoLog(program.id, 512, nullptr, log);
+        std::cerr << "Compute program linking error: " << log << std::endl;
+    }
+    glDeleteShader(computeShader);
+
+    for (int i = 0; i < UNIFORM_SLOT_COUNT; i++)
+        program.uniforms[i] = glGetUniformLocation(program.id, uniformNames[i]);
+
+    GLuint blockIndex = glGetUniformBlockIndex(program.id, "FrameData");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program.id, blockIndex, FRAME_UNIFORM_BINDING);
+
+    setSamplerUnits(program);
+
+    return success == GL_TRUE;
+}
+
+
+void initFrameUniforms() {
+    glGenBuffers(1, &frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void updateFrameUniforms(const FrameUniforms& frame) {
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,79 @@
+﻿#ifndef _SHADER_PROGRAM_H_
+#define _SHADER_PROGRAM_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// 着色器中用到的全部 uniform，链接时一次性查询位置并缓存
+enum UniformSlot {
+    U_MODEL,
+    U_USE_TEXTURE,
+    U_DEFAULT_COLOR,
+    U_TEXTURE_SAMPLER,
+    U_STROKE_TEXTURE,
+    U_NORMAL_MAP,
+    U_BUMP_MAPPING,
+    U_USE_INSTANCING,
+    U_SKYBOX,
+    U_FRUSTUM_PLANES,
+    U_OBJECT_COUNT,
+    U_HIZ_TEXTURE,
+    U_HIZ_PREVIOUS_SIZE,
+    U_HIZ_ENABLED,
+    U_HIZ_SIZE,
+    U_HIZ_LEVELS,
+    U_GBUFFER_COLOR,
+    U_GBUFFER_NORMAL,
+    U_GBUFFER_DEPTH,
+    U_SOURCE_IMAGE,
+    U_SOBEL_SMOOTH,
+    U_FILTER_DIRECTION,
+    U_USE_ALBEDO,
+    UNIFORM_SLOT_COUNT
+};
+
+// 纹理单元分配（采样器 uniform 在链接时设置一次）
+const GLint TEXTURE_UNIT_DIFFUSE = 0;
+const GLint TEXTURE_UNIT_STROKE = 1;
+const GLint TEXTURE_UNIT_NORMAL_MAP = 2;
+const GLint TEXTURE_UNIT_HIZ = 3;
+const GLint TEXTURE_UNIT_GBUFFER_COLOR = 4;
+const GLint TEXTURE_UNIT_GBUFFER_NORMAL = 5;
+const GLint TEXTURE_UNIT_GBUFFER_DEPTH = 6;
+const GLint TEXTURE_UNIT_POST_SOURCE = 7;   // 后处理通道的输入
+const GLint TEXTURE_UNIT_POST_AUX = 8;
+
+// 每帧共享数据，布局与着色器中的 std140 uniform block FrameData 一致
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 viewPosition;  // xyz 有效
+    glm::vec4 lightDir;      // xyz 有效
+};
+
+const GLuint FRAME_UNIFORM_BINDING = 0;
+
+// 着色器中声明 FrameData 的公共片段，拼接在 #version 之后
+extern const char* frameUniformBlockSource;
+
+struct ShaderProgram {
+    GLuint id = 0;
+    GLint uniforms[UNIFORM_SLOT_COUNT];
+
+    GLint operator[](UniformSlot slot) const { return uniforms[slot]; }
+};
+
+// 编译单个着色器
+GLuint compileShader(GLenum shaderType, const char* shaderSource);
+
+// 链接着色器程序，缓存所有 uniform 位置，并把 FrameData 绑定到 FRAME_UNIFORM_BINDING
+bool linkProgram(ShaderProgram& program, const char* vertexSource, const char* fragmentSource);
+
+// 链接计算着色器程序（GL 4.3），同样缓存 uniform 位置
+bool linkComputeProgram(ShaderProgram& program, const char* computeSource);
+
+// 创建/更新每帧 uniform 缓冲，每帧只需调用一次 updateFrameUniforms
+void initFrameUniforms();
+void updateFrameUniforms(const FrameUniforms& frame);
+
+#endif
@@ -0,0 +1,632 @@
+﻿#include "terrain.h"
+#include "stb_image.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include "thread_pool.h"
+#include "mapped_file.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TERRAIN_USE_SSE 1
+#else
+#define TERRAIN_USE_SSE 0
+#endif
+
+// 块的顶点布局：(N+1)^2 个网格顶点，随后是上、下、左、右四条裙边各 N+1 个
+static const int kChunkSide = TERRAIN_CHUNK_QUADS + 1;
+static const int kChunkGridVertices = kChunkSide * kChunkSide;
+static const int kChunkVertices = kChunkGridVertices + kChunkSide * 4;
+
+// 块的采样窗口：比网格多一圈边框，供中心差分使用
+static const int kTileSamples = TERRAIN_TILE_SIDE * TERRAIN_TILE_SIDE;
+
+enum SkirtEdge { SKIRT_TOP, SKIRT_BOTTOM, SKIRT_LEFT, SKIRT_RIGHT };
+
+static const char kTiledMagic[4] = { 'H', 'M', 'T', '1' };
+static const uint32_t kTiledVersion = 2;
+
+// .hmt 文件头，之后是每个块网格采样的高度范围（TiledChunkRange），
+// 再按行优先依次存放每个块的采样窗口（float32，TERRAIN_TILE_SIDE^2 个）
+struct TiledHeightHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t width, height;         // 原高度图尺寸
+    uint32_t chunkQuads, tileSide;  // 必须与当前编译的 TERRAIN_CHUNK_QUADS 一致
+    uint32_t chunksX, chunksZ;
+    uint64_t rangeOffset, tileOffset, fileSize;
+};
+
+struct TiledChunkRange {
+    float minSample, maxSample;
+};
+
+
+static bool hasExtension(const std::string& path, const char* extension) {
+    size_t length = strlen(extension);
+    if (path.size() < length)
+        return false;
+    for (size_t i = 0; i < length; i++) {
+        if (tolower((unsigned char)path[path.size() - length + i]) != extension[i])
+            return false;
+    }
+    return true;
+}
+
+// 原始 float32 高度图：无文件头，正方形，按行存放
+static bool loadRawHeightfield(const char* heightmapFile, Heightfield& field) {
+    MappedFile file;
+    if (!file.open(heightmapFile)) {
+        std::cerr << "Error loading heightmap: " << heightmapFile << std::endl;
+        return false;
+    }
+
+    size_t sampleCount = file.size() / sizeof(float);
+    int side = (int)std::sqrt((double)sampleCount);
+    while ((size_t)(side + 1) * (side + 1) <= sampleCount)
+        side++;
+    if ((size_t)side * side != sampleCount || file.size() % sizeof(float) != 0) {
+        std::cerr << "Raw float heightmap must be a square grid of float32 samples: " << heightmapFile << std::endl;
+        return false;
+    }
+
+    field.width = side;
+    field.height = side;
+    field.samples.resize(sampleCount);
+    memcpy(field.samples.data(), file.data(), sampleCount * sizeof(float));
+    return true;
+}
+
+
+bool loadHeightfield(const char* heightmapFile, Heightfield& field) {
+    if (hasExtension(heightmapFile, ".r32") || hasExtension(heightmapFile, ".raw"))
+        return loadRawHeightfield(heightmapFile, field);
+
+    // 16 位 PNG 保留全部精度，其余格式按 8 位读取
+    int width, height, nrChannels;
+    bool sixteenBit = stbi_is_16_bit(heightmapFile) != 0;
+    void* pixels = sixteenBit ? (void*)stbi_load_16(heightmapFile, &width, &height, &nrChannels, 0)
+                              : (void*)stbi_load(heightmapFile, &width, &height, &nrChannels, 0);
+    if (!pixels) {
+        std::cerr << "Error loading heightmap: " << heightmapFile << std::endl;
+        return false;
+    }
+
+    field.width = width;
+    field.height = height;
+    field.samples.resize((size_t)width * height);
+    workerPool().parallelFor(0, height, 64, [&](size_t firstRow, size_t lastRow) {
+        for (size_t i = firstRow * width; i < lastRow * width; i++) {
+            // 归一化
+            if (sixteenBit)
+                field.samples[i] = (float)((const uint16_t*)pixels)[i * nrChannels] / 65535.0f;
+            else
+                field.samples[i] = (float)((const unsigned char*)pixels)[i * nrChannels] / 255.0f;
+        }
+    });
+
+    stbi_image_free(pixels);
+    return true;
+}
+
+// 取出块的采样窗口（原点向左上偏移一个采样，越界处钳制到边缘）
+static void fillChunkTile(const Heightfield& field, int originX, int originZ, float* tile) {
+    for (int z = 0; z < TERRAIN_TILE_SIDE; z++) {
+        for (int x = 0; x < TERRAIN_TILE_SIDE; x++)
+            tile[z * TERRAIN_TILE_SIDE + x] = field.at(originX + x - 1, originZ + z - 1);
+    }
+}
+
+
+static uint16_t gridIndex(int x, int z) {
+    return (uint16_t)(z * kChunkSide + x);
+}
+
+static uint16_t skirtIndex(SkirtEdge edge, int i) {
+    return (uint16_t)(kChunkGridVertices + edge * kChunkSide + i);
+}
+
+void Terrain::buildLodIndices() {
+    indices.clear();
+    for (int lod = 0; lod < TERRAIN_LOD_COUNT; lod++) {
+        int step = 1 << lod;
+        int quads = TERRAIN_CHUNK_QUADS / step;
+        lodFirstIndex[lod] = indices.size();
+
+        // 网格：每两行一条三角形带，从上方看为逆时针
+        for (int z = 0; z < TERRAIN_CHUNK_QUADS; z += step) {
+            for (int x = 0; x <= TERRAIN_CHUNK_QUADS; x += step) {
+                indices.push_back(gridIndex(x, z));
+                indices.push_back(gridIndex(x, z + step));
+            }
+            indices.push_back(TERRAIN_RESTART_INDEX);
+        }
+
+        // 裙边：沿块边缘向下的竖直带，正面朝外
+        for (int edge = SKIRT_TOP; edge <= SKIRT_RIGHT; edge++) {
+            bool outwardFirst = edge == SKIRT_TOP || edge == SKIRT_RIGHT;
+            for (int i = 0; i <= TERRAIN_CHUNK_QUADS; i += step) {
+                uint16_t grid = edge == SKIRT_TOP ? gridIndex(i, 0) :
+                                edge == SKIRT_BOTTOM ? gridIndex(i, TERRAIN_CHUNK_QUADS) :
+                                edge == SKIRT_LEFT ? gridIndex(0, i) : gridIndex(TERRAIN_CHUNK_QUADS, i);
+                uint16_t skirt = skirtIndex((SkirtEdge)edge, i);
+                indices.push_back(outwardFirst ? skirt : grid);
+                indices.push_back(outwardFirst ? grid : skirt);
+            }
+            indices.push_back(TERRAIN_RESTART_INDEX);
+        }
+
+        lodIndexCount[lod] = indices.size() - lodFirstIndex[lod];
+        lodTriangles[lod] = (size_t)quads * quads * 2 + (size_t)quads * 4 * 2;
+    }
+}
+
+// 一行顶点的法线：法线是两条切线 (0, dh/dz, 1) x (1, dh/dx, 0) 的叉积，
+// 展开后为 (-dh/dx, 1, -dh/dz)，SSE 下每次计算 4 个顶点的斜率与归一化
+static void computeRowNormals(const float* left, const float* right, const float* up, const float* down,
+                              const float* inverseDx, const float* inverseDz, int count, float* normals) {
+    int x = 0;
+#if TERRAIN_USE_SSE
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; x + 4 <= count; x += 4) {
+        __m128 slopeX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(right + x), _mm_loadu_ps(left + x)), _mm_loadu_ps(inverseDx + x));
+        __m128 slopeZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(down + x), _mm_loadu_ps(up + x)), _mm_loadu_ps(inverseDz + x));
+        __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(slopeX, slopeX), _mm_mul_ps(slopeZ, slopeZ)), one);
+        __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+
+        // 结果按 x、y、z 三个平面存放，写顶点时再交错
+        _mm_storeu_ps(normals + x, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(slopeX, inverseLength)));
+        _mm_storeu_ps(normals + kChunkSide + x, inverseLength);
+        _mm_storeu_ps(normals + kChunkSide * 2 + x, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(slopeZ, inverseLength)));
+    }
+#endif
+    for (; x < count; x++) {
+        float slopeX = (right[x] - left[x]) * inverseDx[x];
+        float slopeZ = (down[x] - up[x]) * inverseDz[x];
+        float inverseLength = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+        normals[x] = -slopeX * inverseLength;
+        normals[kChunkSide + x] = inverseLength;
+        normals[kChunkSide * 2 + x] = -slopeZ * inverseLength;
+    }
+}
+
+// 由块内网格顶点的高度范围设置包围盒（包含裙边），返回裙边深度
+static float setChunkBounds(float minHeight, float maxHeight, int fieldWidth, int fieldHeight, glm::vec3 scale, TerrainChunk& chunk) {
+    // 裙边深度取块内高差：足以盖住任何 LOD 组合下的裂缝
+    float skirtDepth = std::max(maxHeight - minHeight, std::fabs(scale.y) * 0.01f);
+    int lastX = std::min(chunk.originX + TERRAIN_CHUNK_QUADS, fieldWidth - 1);
+    int lastZ = std::min(chunk.originZ + TERRAIN_CHUNK_QUADS, fieldHeight - 1);
+    chunk.boundsMin = glm::vec3(chunk.originX * scale.x, minHeight - skirtDepth, chunk.originZ * scale.z);
+    chunk.boundsMax = glm::vec3(lastX * scale.x, maxHeight, lastZ * scale.z);
+    return skirtDepth;
+}
+
+// 构建一个块的网格顶点、裙边和包围盒（只写入本块的顶点，可并行）
+static void buildChunk(const float* tile, int fieldWidth, int fieldHeight, glm::vec3 scale, TerrainChunk& chunk, Vertex* out) {
+    // 每行的邻居高度与差分间距，供 computeRowNormals 成组计算
+    float left[kChunkSide], right[kChunkSide], up[kChunkSide], down[kChunkSide];
+    float inverseDx[kChunkSide], inverseDz[kChunkSide], normals[kChunkSide * 3];
+
+    float minHeight = FLT_MAX, maxHeight = -FLT_MAX;
+    for (int z = 0; z < kChunkSide; z++) {
+        // 超出高度图的部分钳制到边缘（退化为零面积三角形）
+        int sz = std::min(chunk.originZ + z, fieldHeight - 1);
+        int z0 = sz > 0 ? sz - 1 : sz, z1 = sz < fieldHeight - 1 ? sz + 1 : sz;
+        const float* row = tile + (z + 1) * TERRAIN_TILE_SIDE + 1;
+
+        // 中心差分，边缘处退化为单侧差分（窗口边框已钳制为边缘值）
+        for (int x = 0; x < kChunkSide; x++) {
+            int sx = std::min(chunk.originX + x, fieldWidth - 1);
+            int x0 = sx > 0 ? sx - 1 : sx, x1 = sx < fieldWidth - 1 ? sx + 1 : sx;
+            left[x] = row[x - 1];
+            right[x] = row[x + 1];
+            up[x] = row[x - TERRAIN_TILE_SIDE];
+            down[x] = row[x + TERRAIN_TILE_SIDE];
+            inverseDx[x] = scale.y / ((x1 - x0) * scale.x);
+            inverseDz[x] = scale.y / ((z1 - z0) * scale.z);
+        }
+        computeRowNormals(left, right, up, down, inverseDx, inverseDz, kChunkSide, normals);
+
+        for (int x = 0; x < kChunkSide; x++) {
+            int sx = std::min(chunk.originX + x, fieldWidth - 1);
+            float y = row[x] * scale.y;
+
+            Vertex& v = out[gridIndex(x, z)];
+            v.position[0] = (float)sx * scale.x;
+            v.position[1] = y;
+            v.position[2] = (float)sz * scale.z;
+            v.normal[0] = normals[x];
+            v.normal[1] = normals[kChunkSide + x];
+            v.normal[2] = normals[kChunkSide * 2 + x];
+            v.texCoord[0] = (float)sx / (fieldWidth - 1);
+            v.texCoord[1] = (float)sz / (fieldHeight - 1);
+
+            minHeight = std::min(minHeight, y);
+            maxHeight = std::max(maxHeight, y);
+        }
+    }
+
+    float skirtDepth = setChunkBounds(minHeight, maxHeight, fieldWidth, fieldHeight, scale, chunk);
+    for (int i = 0; i < kChunkSide; i++) {
+        const int gridOf[4] = { gridIndex(i, 0), gridIndex(i, TERRAIN_CHUNK_QUADS), gridIndex(0, i), gridIndex(TERRAIN_CHUNK_QUADS, i) };
+        for (int edge = SKIRT_TOP; edge <= SKIRT_RIGHT; edge++) {
+            Vertex& skirt = out[skirtIndex((SkirtEdge)edge, i)];
+            skirt = out[gridOf[edge]];
+            skirt.position[1] -= skirtDepth;
+        }
+    }
+}
+
+void Terrain::buildChunks(int width, int height, glm::vec3 scale, const TileSource& tileSource) {
+    release();
+    chunks.clear();
+    vertices.clear();
+    tiledFile.reset();
+    tiles = nullptr;
+    if (width < 2 || height < 2)
+        return;
+
+    int chunksX = (width - 2) / TERRAIN_CHUNK_QUADS + 1;
+    int chunksZ = (height - 2) / TERRAIN_CHUNK_QUADS + 1;
+    chunks.resize((size_t)chunksX * chunksZ);
+    vertices.resize(chunks.size() * kChunkVertices);
+
+    // 按块行分带并行：每个块只写自己的顶点区间和包围盒，没有共享写入
+    workerPool().parallelFor(0, chunksZ, 1, [&](size_t firstRow, size_t lastRow) {
+        std::vector<float> scratch(kTileSamples);
+        for (size_t cz = firstRow; cz < lastRow; cz++) {
+            for (int cx = 0; cx < chunksX; cx++) {
+                size_t chunkIndex = cz * chunksX + cx;
+                TerrainChunk& chunk = chunks[chunkIndex];
+                chunk.originX = cx * TERRAIN_CHUNK_QUADS;
+                chunk.originZ = (int)cz * TERRAIN_CHUNK_QUADS;
+                chunk.slot = (int)chunkIndex;
+                chunk.baseVertex = (GLint)(chunkIndex * kChunkVertices);
+                const float* tile = tileSource(cx, (int)cz, scratch.data());
+                buildChunk(tile, width, height, scale, chunk, &vertices[chunk.baseVertex]);
+            }
+        }
+    });
+
+    slotOwner.resize(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+        slotOwner[i] = (int)i;
+
+    // 归并整体包围盒（包含裙边）
+    boundsMin = glm::vec3(0.0f, FLT_MAX, 0.0f);
+    boundsMax = glm::vec3((width - 1) * scale.x, -FLT_MAX, (height - 1) * scale.z);
+    for (const TerrainChunk& chunk : chunks) {
+        boundsMin.y = std::min(boundsMin.y, chunk.boundsMin.y);
+        boundsMax.y = std::max(boundsMax.y, chunk.boundsMax.y);
+    }
+
+    buildLodIndices();
+}
+
+void Terrain::build(const Heightfield& field, glm::vec3 scale) {
+    buildChunks(field.width, field.height, scale, [&field](int cx, int cz, float* scratch) {
+        fillChunkTile(field, cx * TERRAIN_CHUNK_QUADS, cz * TERRAIN_CHUNK_QUADS, scratch);
+        return (const float*)scratch;
+    });
+}
+
+bool Terrain::openTiled(const char* tiledPath, glm::vec3 scale) {
+    release();
+    chunks.clear();
+    vertices.clear();
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    TiledHeightHeader header;
+    if (!file->open(tiledPath) || file->size() < sizeof(header)) {
+        std::cerr << "Error loading heightmap: " << tiledPath << std::endl;
+        return false;
+    }
+    memcpy(&header, file->data(), sizeof(header));
+
+    uint64_t tileBytes = (uint64_t)kTileSamples * sizeof(float);
+    uint64_t chunkCount = (uint64_t)header.chunksX * header.chunksZ;
+    if (memcmp(header.magic, kTiledMagic, 4) != 0 || header.version != kTiledVersion ||
+        header.chunkQuads != TERRAIN_CHUNK_QUADS || header.tileSide != TERRAIN_TILE_SIDE ||
+        header.width < 2 || header.height < 2 ||
+        header.chunksX != (header.width - 2) / TERRAIN_CHUNK_QUADS + 1 ||
+        header.chunksZ != (header.height - 2) / TERRAIN_CHUNK_QUADS + 1 ||
+        header.fileSize != file->size() ||
+        header.rangeOffset + chunkCount * sizeof(TiledChunkRange) > file->size() ||
+        header.tileOffset + chunkCount * tileBytes > file->size()) {
+        std::cerr << "Invalid or incompatible tiled heightmap (re-run --convert-heightmap): " << tiledPath << std::endl;
+        return false;
+    }
+
+    // 只读取高度范围表建立包围盒，采样窗口在块被调入时才由操作系统分页读入
+    const TiledChunkRange* ranges = (const TiledChunkRange*)(file->data() + header.rangeOffset);
+    fieldWidth = (int)header.width;
+    fieldHeight = (int)header.height;
+    tiledScale = scale;
+    chunks.resize((size_t)chunkCount);
+    boundsMin = glm::vec3(0.0f, FLT_MAX, 0.0f);
+    boundsMax = glm::vec3((fieldWidth - 1) * scale.x, -FLT_MAX, (fieldHeight - 1) * scale.z);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        TerrainChunk& chunk = chunks[i];
+        chunk.originX = (int)(i % header.chunksX) * TERRAIN_CHUNK_QUADS;
+        chunk.originZ = (int)(i / header.chunksX) * TERRAIN_CHUNK_QUADS;
+        float low = ranges[i].minSample * scale.y, high = ranges[i].maxSample * scale.y;
+        setChunkBounds(std::min(low, high), std::max(low, high), fieldWidth, fieldHeight, scale, chunk);
+        boundsMin.y = std::min(boundsMin.y, chunk.boundsMin.y);
+        boundsMax.y = std::max(boundsMax.y, chunk.boundsMax.y);
+    }
+
+    slotOwner.assign(std::min(chunks.size(), std::max(residentLimit, (size_t)1)), -1);
+    tiles = file->data() + header.tileOffset;
+    tiledFile = file;
+    buildLodIndices();
+    return true;
+}
+
+bool Terrain::load(const char* heightmapFile, glm::vec3 scale) {
+    auto buildStart = std::chrono::steady_clock::now();
+    int width = 0, height = 0;
+    if (hasExtension(heightmapFile, ".hmt")) {
+        if (!openTiled(heightmapFile, scale))
+            return false;
+        width = fieldWidth;
+        height = fieldHeight;
+    }
+    else {
+        Heightfield field;
+        if (!loadHeightfield(heightmapFile, field))
+            return false;
+        build(field, scale);
+        width = field.width;
+        height = field.height;
+    }
+    double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+    std::cout << "Heightmap loaded: " << heightmapFile << std::endl;
+    std::cout << "Terrain size: " << width << "x" << height << ", chunks: " << chunks.size()
+              << " (" << TERRAIN_CHUNK_QUADS << "x" << TERRAIN_CHUNK_QUADS << ", " << TERRAIN_LOD_COUNT << " LODs)";
+    if (tiles)
+        std::cout << ", paged on demand into " << slotOwner.size() << " resident slots, opened in " << buildMs << " ms" << std::endl;
+    else
+        std::cout << ", vertices: " << vertices.size() << ", built in " << buildMs << " ms on "
+                  << workerPool().threadCount() + 1 << " threads" << std::endl;
+    return !chunks.empty();
+}
+
+bool writeTiledHeightfield(const Heightfield& field, const char* tiledFile) {
+    if (field.width < 2 || field.height < 2)
+        return false;
+
+    TiledHeightHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kTiledMagic, 4);
+    header.version = kTiledVersion;
+    header.width = (uint32_t)field.width;
+    header.height = (uint32_t)field.height;
+    header.chunkQuads = TERRAIN_CHUNK_QUADS;
+    header.tileSide = TERRAIN_TILE_SIDE;
+    header.chunksX = (header.width - 2) / TERRAIN_CHUNK_QUADS + 1;
+    header.chunksZ = (header.height - 2) / TERRAIN_CHUNK_QUADS + 1;
+    uint64_t chunkCount = (uint64_t)header.chunksX * header.chunksZ;
+    header.rangeOffset = sizeof(header);
+    header.tileOffset = (header.rangeOffset + chunkCount * sizeof(TiledChunkRange) + 63) & ~(uint64_t)63;
+    header.fileSize = header.tileOffset + chunkCount * kTileSamples * sizeof(float);
+
+    // 各块网格采样（窗口去掉边框）的高度范围，加载时用来建立包围盒
+    std::vector<float> tile(kTileSamples);
+    std::vector<TiledChunkRange> ranges((size_t)chunkCount);
+    for (uint32_t cz = 0; cz < header.chunksZ; cz++) {
+        for (uint32_t cx = 0; cx < header.chunksX; cx++) {
+            fillChunkTile(field, (int)cx * TERRAIN_CHUNK_QUADS, (int)cz * TERRAIN_CHUNK_QUADS, tile.data());
+            TiledChunkRange& range = ranges[(size_t)cz * header.chunksX + cx];
+            range.minSample = FLT_MAX;
+            range.maxSample = -FLT_MAX;
+            for (int z = 1; z <= kChunkSide; z++) {
+                for (int x = 1; x <= kChunkSide; x++) {
+                    range.minSample = std::min(range.minSample, tile[z * TERRAIN_TILE_SIDE + x]);
+                    range.maxSample = std::max(range.maxSample, tile[z * TERRAIN_TILE_SIDE + x]);
+                }
+            }
+        }
+    }
+
+    std::ofstream file(tiledFile, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)ranges.data(), (std::streamsize)(ranges.size() * sizeof(TiledChunkRange)));
+    static const char padding[64] = {};
+    file.write(padding, (std::streamsize)(header.tileOffset - header.rangeOffset - ranges.size() * sizeof(TiledChunkRange)));
+
+    for (uint32_t cz = 0; cz < header.chunksZ; cz++) {
+        for (uint32_t cx = 0; cx < header.chunksX; cx++) {
+            fillChunkTile(field, (int)cx * TERRAIN_CHUNK_QUADS, (int)cz * TERRAIN_CHUNK_QUADS, tile.data());
+            file.write((const char*)tile.data(), (std::streamsize)(tile.size() * sizeof(float)));
+        }
+    }
+    return (bool)file;
+}
+
+void Terrain::upload() {
+    if (chunks.empty())
+        return;
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glBindVertexArray(vao);
+
+    // .hmt 只分配槽位，块的顶点由 update 调入
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (tiles)
+        glBufferData(GL_ARRAY_BUFFER, slotOwner.size() * kChunkVertices * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+    else
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    setupVertexAttributes(VERTEX_FORMAT_FLOAT);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    std::vector<Vertex>().swap(vertices);
+    residentChunks = tiles ? 0 : chunks.size();
+}
+
+void Terrain::release() {
+    if (vao) {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+    }
+    vao = vbo = ebo = 0;
+
+    // 按需调入的块随缓冲一起失效
+    if (tiles) {
+        for (TerrainChunk& chunk : chunks)
+            chunk.slot = -1;
+        std::fill(slotOwner.begin(), slotOwner.end(), -1);
+        residentChunks = 0;
+    }
+}
+
+// 取一个空闲槽位；没有时淘汰本帧不可见、最久未见的块，全部可见时返回 -1
+int Terrain::acquireSlot() {
+    int victim = -1;
+    for (size_t slot = 0; slot < slotOwner.size(); slot++) {
+        if (slotOwner[slot] < 0)
+            return (int)slot;
+        const TerrainChunk& owner = chunks[slotOwner[slot]];
+        if (owner.lastVisibleFrame != frameIndex &&
+            (victim < 0 || owner.lastVisibleFrame < chunks[slotOwner[victim]].lastVisibleFrame))
+            victim = (int)slot;
+    }
+    if (victim >= 0) {
+        chunks[slotOwner[victim]].slot = -1;
+        slotOwner[victim] = -1;
+        residentChunks--;
+    }
+    return victim;
+}
+
+void Terrain::update(const glm::vec3& cameraPosition, const Frustum& frustum) {
+    if (!tiles || !vao)
+        return;
+    frameIndex++;
+
+    glm::vec3 camera = cameraPosition - position;
+    std::vector<TerrainChunk*> missing;
+    for (TerrainChunk& chunk : chunks) {
+        if (!boxInFrustum(frustum, chunk.boundsMin + position, chunk.boundsMax + position))
+            continue;
+        chunk.lastVisibleFrame = frameIndex;
+        if (chunk.slot < 0) {
+            chunk.distance = glm::length(camera - glm::clamp(camera, chunk.boundsMin, chunk.boundsMax));
+            missing.push_back(&chunk);
+        }
+    }
+    if (missing.empty())
+        return;
+
+    // 由近到远调入，每帧数量有限，避免转身时一次构建过多的块
+    size_t loads = std::min(missing.size(), (size_t)std::max(chunkLoadsPerFrame, 1));
+    std::partial_sort(missing.begin(), missing.begin() + loads, missing.end(),
+                      [](const TerrainChunk* a, const TerrainChunk* b) { return a->distance < b->distance; });
+
+    // 槽位立即记到新主人名下，后续的 acquireSlot 不会重复分配，也不会淘汰本帧可见的块
+    std::vector<int> slots;
+    for (size_t i = 0; i < loads; i++) {
+        int slot = acquireSlot();
+        if (slot < 0)
+            break;
+        slotOwner[slot] = (int)(missing[i] - chunks.data());
+        slots.push_back(slot);
+    }
+    if (slots.empty())
+        return;
+
+    // 顶点在线程池中构建，随后逐块写入各自的槽位
+    size_t tileBytes = (size_t)kTileSamples * sizeof(float);
+    int chunksX = (fieldWidth - 2) / TERRAIN_CHUNK_QUADS + 1;
+    std::vector<Vertex> built(slots.size() * kChunkVertices);
+    workerPool().parallelFor(0, slots.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            TerrainChunk& chunk = *missing[i];
+            size_t chunkIndex = (size_t)(chunk.originZ / TERRAIN_CHUNK_QUADS) * chunksX + chunk.originX / TERRAIN_CHUNK_QUADS;
+            buildChunk((const float*)(tiles + chunkIndex * tileBytes), fieldWidth, fieldHeight, tiledScale, chunk, &built[i * kChunkVertices]);
+        }
+    });
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    for (size_t i = 0; i < slots.size(); i++) {
+        TerrainChunk& chunk = *missing[i];
+        chunk.slot = slots[i];
+        chunk.baseVertex = (GLint)(slots[i] * kChunkVertices);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)chunk.baseVertex * sizeof(Vertex), kChunkVertices * sizeof(Vertex), &built[i * kChunkVertices]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    residentChunks += slots.size();
+}
+
+void Terrain::selectLod(const glm::vec3& cameraPosition, const Frustum& frustum) {
+    glm::vec3 camera = cameraPosition - position;
+
+    // 按到包围盒的距离选择 LOD：每超过一倍 lodDistance 降一级；
+    // 预算只统计 draw 会提交的块（已调入且在视锥内）
+    size_t triangles = 0;
+    std::vector<TerrainChunk*> byDistance;
+    for (TerrainChunk& chunk : chunks) {
+        if (chunk.slot < 0 || !boxInFrustum(frustum, chunk.boundsMin + position, chunk.boundsMax + position))
+            continue;
+        glm::vec3 nearest = glm::clamp(camera, chunk.boundsMin, chunk.boundsMax);
+        chunk.distance = glm::length(camera - nearest);
+        int lod = 0;
+        for (float range = lodDistance; chunk.distance > range && lod < TERRAIN_LOD_COUNT - 1; range *= 2.0f)
+            lod++;
+        chunk.lod = lod;
+        triangles += lodTriangles[lod];
+        byDistance.push_back(&chunk);
+    }
+
+    // 超出预算时从最远的块开始逐级降低精度
+    if (triangles > triangleBudget) {
+        std::sort(byDistance.begin(), byDistance.end(),
+                  [](const TerrainChunk* a, const TerrainChunk* b) { return a->distance > b->distance; });
+
+        bool changed = true;
+        while (triangles > triangleBudget && changed) {
+            changed = false;
+            for (size_t i = 0; i < byDistance.size() && triangles > triangleBudget; i++) {
+                TerrainChunk& chunk = *byDistance[i];
+                if (chunk.lod == TERRAIN_LOD_COUNT - 1)
+                    continue;
+                triangles -= lodTriangles[chunk.lod] - lodTriangles[chunk.lod + 1];
+                chunk.lod++;
+                changed = true;
+            }
+        }
+    }
+    drawnTriangles = triangles;
+}
+
+void Terrain::draw(const Frustum& frustum) {
+    drawnChunks = 0;
+    if (!vao)
+        return;
+
+    glBindVertexArray(vao);
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(TERRAIN_RESTART_INDEX);
+    for (const TerrainChunk& chunk : chunks) {
+        // 块包围盒在地形局部空间，地形只有平移
+        if (chunk.slot < 0 || !boxInFrustum(frustum, chunk.boundsMin + position, chunk.boundsMax + position))
+            continue;
+        drawnChunks++;
+        glDrawElementsBaseVertex(GL_TRIANGLE_STRIP, (GLsizei)lodIndexCount[chunk.lod], GL_UNSIGNED_SHORT,
+                                 (void*)(lodFirstIndex[chunk.lod] * sizeof(uint16_t)), chunk.baseVertex);
+    }
+    glDisable(GL_PRIMITIVE_RESTART);
+    glBindVertexArray(0);
+}
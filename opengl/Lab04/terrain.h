@@ -0,0 +1,120 @@
+﻿#ifndef _TERRAIN_H_
+#define _TERRAIN_H_
+
+#include <GL/glew.h>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "culling.h"
+
+class MappedFile;
+
+// 16 位索引中的图元重启标记
+const uint16_t TERRAIN_RESTART_INDEX = 0xffff;
+
+// 每个地形块的格子数（每边），以及 LOD 级数：LOD l 每隔 2^l 个采样取一个顶点
+const int TERRAIN_CHUNK_QUADS = 64;
+const int TERRAIN_LOD_COUNT = 5;
+
+// 每个块的采样窗口边长：网格 N+1 个采样，外加四周各一个用于中心差分
+const int TERRAIN_TILE_SIDE = TERRAIN_CHUNK_QUADS + 3;
+
+// 高度场：按行存放的高度（图片归一化到 0..1，float32 原始数据保持原值），乘以 scale.y 得到高度
+struct Heightfield {
+    int width = 0;
+    int height = 0;
+    std::vector<float> samples;
+
+    // 越界坐标钳制到边缘
+    float at(int x, int z) const {
+        x = x < 0 ? 0 : (x >= width ? width - 1 : x);
+        z = z < 0 ? 0 : (z >= height ? height - 1 : z);
+        return samples[(size_t)z * width + x];
+    }
+};
+
+// 读取高度图，失败返回 false：
+//   图片：取第一个通道，16 位 PNG 保留完整精度
+//   .r32/.raw：无文件头的正方形 float32 数据
+bool loadHeightfield(const char* heightmapFile, Heightfield& field);
+
+// 转换为分块的 .hmt 文件：每个块的高度范围表 + 各块连续存放的采样窗口。
+// 加载时只读范围表建立包围盒，块的顶点在进入视锥时才从映射的窗口构建并上传
+bool writeTiledHeightfield(const Heightfield& field, const char* tiledFile);
+
+// 地形块：独立的局部顶点网格（含四周的裙边），绘制时用 baseVertex 偏移到共享顶点缓冲
+struct TerrainChunk {
+    int originX = 0, originZ = 0;   // 块左上角的采样坐标
+    glm::vec3 boundsMin, boundsMax; // 地形局部空间包围盒
+    GLint baseVertex = 0;
+    int slot = -1;                  // 在共享顶点缓冲中占用的槽位，-1 表示未驻留（.hmt 按需调入）
+    unsigned lastVisibleFrame = 0;  // 最近一次在视锥内的帧号，槽位不足时淘汰最久未见的块
+    int lod = 0;                    // 本帧选中的 LOD
+    float distance = 0.0f;          // 本帧到相机的距离
+};
+
+// 分块几何 MIP 地形（geomipmapping）：每个 LOD 一份索引缓冲，所有块共用；
+// 相邻块 LOD 不同产生的裂缝由向下延伸的裙边遮住
+class Terrain {
+public:
+    glm::vec3 position = glm::vec3(0.0f); // 地形局部原点在世界中的位置
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    float lodDistance = 8.0f;             // LOD 0 覆盖的距离，之后每级翻倍
+    size_t triangleBudget = 500000;       // 每帧三角形上限，超出时从远处开始降级
+    size_t drawnTriangles = 0;
+    size_t residentLimit = 256;           // .hmt 同时驻留的块数上限（顶点缓冲的槽位数）
+    int chunkLoadsPerFrame = 16;          // .hmt 每帧最多调入的块数
+
+    // 载入高度图，scale 为每个采样的间距与高度缩放。图片与 .r32 立即构建所有块（CPU）；
+    // 分块的 .hmt 只建立块的包围盒，顶点由 update 按需构建
+    bool load(const char* heightmapFile, glm::vec3 scale);
+    void build(const Heightfield& field, glm::vec3 scale);
+
+    // 创建 GPU 缓冲，之后 CPU 端顶点被释放（.hmt 只分配槽位）
+    void upload();
+    void release();
+    bool isReady() const { return vao != 0; }
+
+    // .hmt：把视锥内尚未驻留的块（由近到远，每帧不超过 chunkLoadsPerFrame 个）构建并上传到空闲槽位，
+    // 槽位用完时淘汰本帧不可见、最久未见的块。未驻留的块不绘制
+    void update(const glm::vec3& cameraPosition, const Frustum& frustum);
+    size_t residentChunks = 0;
+
+    // 按相机位置（世界空间）为视锥内的已驻留块选择 LOD，三角形预算只计这些块
+    void selectLod(const glm::vec3& cameraPosition, const Frustum& frustum);
+
+    // 绘制与视锥相交的块（调用者已设置好模型矩阵等 uniform），frustum 为世界空间
+    void draw(const Frustum& frustum);
+    size_t drawnChunks = 0;
+
+    size_t chunkCount() const { return chunks.size(); }
+
+private:
+    std::vector<TerrainChunk> chunks;
+    std::vector<Vertex> vertices;           // 所有块的顶点，上传后清空
+    std::vector<uint16_t> indices;          // 所有 LOD 的索引依次拼接
+    size_t lodFirstIndex[TERRAIN_LOD_COUNT];
+    size_t lodIndexCount[TERRAIN_LOD_COUNT];
+    size_t lodTriangles[TERRAIN_LOD_COUNT];
+    GLuint vao = 0, vbo = 0, ebo = 0;
+
+    // 分块高度图保持映射，块的采样窗口在调入时读取
+    std::shared_ptr<MappedFile> tiledFile;
+    const unsigned char* tiles = nullptr;
+    glm::vec3 tiledScale = glm::vec3(1.0f);
+    int fieldWidth = 0, fieldHeight = 0;
+    std::vector<int> slotOwner;             // 每个槽位当前所属的块，-1 为空闲
+    unsigned frameIndex = 0;
+
+    // 返回块 (cx, cz) 的采样窗口，scratch 为可供填充的 TERRAIN_TILE_SIDE^2 个 float
+    typedef std::function<const float*(int cx, int cz, float* scratch)> TileSource;
+
+    void buildLodIndices();
+    void buildChunks(int width, int height, glm::vec3 scale, const TileSource& tileSource);
+    bool openTiled(const char* tiledFile, glm::vec3 scale);
+    int acquireSlot();
+};
+
+#endif
@@ -0,0 +1,389 @@
+﻿#include "texture_cache.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+#include "texture_streamer.h"
+#include "ktx2.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cctype>
+
+#if defined(_WIN32)
+#include <stdlib.h>
+#else
+#include <limits.h>
+#endif
+
+TextureCache textureCache;
+bool compressedTexturesEnabled = true;
+
+
+std::string canonicalPath(const std::string& path) {
+    std::string result = path;
+#if defined(_WIN32)
+    char buffer[_MAX_PATH];
+    if (_fullpath(buffer, path.c_str(), _MAX_PATH))
+        result = buffer;
+    for (size_t i = 0; i < result.size(); i++) {
+        if (result[i] == '\\')
+            result[i] = '/';
+        else
+            result[i] = (char)tolower((unsigned char)result[i]); // Windows 路径不区分大小写
+    }
+#else
+    char buffer[PATH_MAX];
+    if (realpath(path.c_str(), buffer))
+        result = buffer;
+#endif
+    return result;
+}
+
+DecodedImage::~DecodedImage() {
+    if (pixels)
+        stbi_image_free(pixels);
+}
+
+DecodedImagePtr decodeImage(const std::string& path) {
+    DecodedImagePtr image = std::make_shared<DecodedImage>();
+    image->pixels = stbi_load(path.c_str(), &image->width, &image->height, &image->channels, 0);
+    return image;
+}
+
+std::string compressedTexturePath(const std::string& path) {
+    if (!compressedTexturesEnabled)
+        return std::string();
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash) || path.compare(dot, std::string::npos, ".ktx2") == 0)
+        return std::string();
+
+    std::string compressed = path.substr(0, dot) + ".ktx2";
+    return std::ifstream(compressed.c_str()) ? compressed : std::string();
+}
+
+bool glFormatForKtx2(uint32_t vkFormat, GLenum& internalFormat, GLenum& format) {
+    format = 0;
+    switch (vkFormat) {
+    case KTX2_FORMAT_R8G8_UNORM:
+        internalFormat = GL_RG8;
+        format = GL_RG;
+        return true;
+    case KTX2_FORMAT_R8G8B8A8_UNORM:
+        internalFormat = GL_RGBA8;
+        format = GL_RGBA;
+        return true;
+    case KTX2_FORMAT_R8G8B8A8_SRGB:
+        internalFormat = GL_SRGB8_ALPHA8;
+        format = GL_RGBA;
+        return true;
+    case KTX2_FORMAT_BC1_RGB_UNORM:
+        internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        return GLEW_EXT_texture_compression_s3tc != 0;
+    case KTX2_FORMAT_BC1_RGB_SRGB:
+        internalFormat = GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+        return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+    case KTX2_FORMAT_BC3_UNORM:
+        internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        return GLEW_EXT_texture_compression_s3tc != 0;
+    case KTX2_FORMAT_BC3_SRGB:
+        internalFormat = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+        return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+    case KTX2_FORMAT_BC5_UNORM:
+        internalFormat = GL_COMPRESSED_RG_RGTC2; // GL 3.0 核心
+        return true;
+    case KTX2_FORMAT_BC7_UNORM:
+        internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+        return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+    case KTX2_FORMAT_BC7_SRGB:
+        internalFormat = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+        return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+    }
+    return false;
+}
+
+// 上传 KTX2 的一级（target 为 2D、数组或立方体贴图的某个面），data 为该级全部层的数据
+static void uploadKtx2Level(GLenum target, int level, const Ktx2Texture& image, GLenum internalFormat, GLenum format, const uint8_t* data) {
+    GLsizei width = image.levelWidth(level), height = image.levelHeight(level);
+    if (target == GL_TEXTURE_2D_ARRAY) {
+        GLsizei size = (GLsizei)(image.imageSize(level) * image.layers);
+        if (format)
+            glTexImage3D(target, level, internalFormat, width, height, image.layers, 0, format, GL_UNSIGNED_BYTE, data);
+        else
+            glCompressedTexImage3D(target, level, internalFormat, width, height, image.layers, 0, size, data);
+    }
+    else {
+        if (format)
+            glTexImage2D(target, level, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        else
+            glCompressedTexImage2D(target, level, internalFormat, width, height, 0, (GLsizei)image.imageSize(level), data);
+    }
+}
+
+// 按 KTX2 的层数/面数创建纹理并上传文件中的 MIP 链，格式不受支持时返回 0
+static GLuint createKtx2Texture(const Ktx2Texture& image, const TextureSettings& settings, const std::string& path) {
+    GLenum internalFormat, format;
+    if (!glFormatForKtx2(image.vkFormat, internalFormat, format)) {
+        std::cerr << "Unsupported KTX2 format " << image.vkFormat << ": " << path << std::endl;
+        return 0;
+    }
+
+    GLenum target = image.layers > 0 ? GL_TEXTURE_2D_ARRAY : image.faces == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    int levelCount = settings.mipmaps ? (int)image.levels.size() : 1;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = 0; level < levelCount; level++) {
+        const uint8_t* data = image.levels[level].data();
+        if (target == GL_TEXTURE_CUBE_MAP) {
+            for (int face = 0; face < 6; face++)
+                uploadKtx2Level(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, image, internalFormat, format, data + image.imageSize(level) * face);
+        }
+        else {
+            uploadKtx2Level(target, level, image, internalFormat, format, data);
+        }
+    }
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, settings.wrap);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, settings.wrap);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, settings.wrap);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, settings.minFilter);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, settings.magFilter);
+    return texture;
+}
+
+// 六个面都有同格式、同尺寸的压缩纹理时创建压缩立方体贴图，否则返回 0。
+// 与未压缩的天空盒一致只上传第 0 级（GL_LINEAR 采样）
+static GLuint createCompressedCubeMap(const std::vector<std::string>& faces) {
+    if (faces.size() != 6)
+        return 0;
+
+    std::vector<Ktx2Texture> images(faces.size());
+    for (size_t i = 0; i < faces.size(); i++) {
+        std::string compressed = compressedTexturePath(faces[i]);
+        if (compressed.empty() || !readKtx2(compressed, images[i]) || images[i].layers != 0 || images[i].faces != 1 ||
+            images[i].vkFormat != images[0].vkFormat || images[i].width != images[0].width || images[i].height != images[0].height)
+            return 0;
+    }
+    GLenum internalFormat, format;
+    if (!glFormatForKtx2(images[0].vkFormat, internalFormat, format))
+        return 0;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int face = 0; face < 6; face++)
+        uploadKtx2Level(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, images[face], internalFormat, format, images[face].levels[0].data());
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+static GLenum formatForChannels(int nrChannels) {
+    if (nrChannels == 1)
+        return GL_RED;
+    if (nrChannels == 4)
+        return GL_RGBA;
+    return GL_RGB;
+}
+
+static std::string settingsKey(const TextureSettings& settings) {
+    return "|" + std::to_string(settings.wrap) + "," + std::to_string(settings.minFilter) + "," +
+           std::to_string(settings.magFilter) + "," + (settings.mipmaps ? "1" : "0");
+}
+
+
+GLuint TextureCache::lookup(const std::string& key) {
+    std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+    if (it == entries.end())
+        return 0;
+    it->second.refCount++;
+    return it->second.texture;
+}
+
+void TextureCache::insert(const std::string& key, GLuint texture) {
+    Entry entry;
+    entry.texture = texture;
+    entry.refCount = 1;
+    entries[key] = entry;
+    keyByTexture[texture] = key;
+}
+
+void TextureCache::prefetch2D(const std::string& path) {
+    // 有压缩纹理时 acquire 直接读取它，不需要解码原图
+    if (!compressedTexturePath(path).empty())
+        return;
+
+    std::string key = canonicalPath(path);
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    if (pendingImages.count(key))
+        return;
+    pendingImages[key] = workerPool().submit([path]() { return decodeImage(path); }).share();
+}
+
+void TextureCache::prefetchCubeMap(const std::vector<std::string>& faces) {
+    for (size_t i = 0; i < faces.size(); i++)
+        prefetch2D(faces[i]);
+}
+
+void TextureCache::dropPrefetched() {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    pendingImages.clear();
+}
+
+// 取出预取的解码任务，没有预取时返回无效的 future
+std::shared_future<DecodedImagePtr> TextureCache::takeImageAsync(const std::string& path) {
+    std::shared_future<DecodedImagePtr> pending;
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    std::unordered_map<std::string, std::shared_future<DecodedImagePtr>>::iterator it = pendingImages.find(canonicalPath(path));
+    if (it != pendingImages.end()) {
+        pending = it->second;
+        pendingImages.erase(it);
+    }
+    return pending;
+}
+
+// 取出预取的图片（必要时等待解码完成），没有预取时同步解码
+DecodedImagePtr TextureCache::takeImage(const std::string& path) {
+    std::shared_future<DecodedImagePtr> pending = takeImageAsync(path);
+    return pending.valid() ? pending.get() : decodeImage(path);
+}
+
+GLuint TextureCache::acquire2D(const std::string& path, const TextureSettings& settings) {
+    std::string key = canonicalPath(path) + settingsKey(settings);
+    GLuint texture = lookup(key);
+    if (texture)
+        return texture;
+
+    std::string compressed = compressedTexturePath(path);
+    if (!compressed.empty()) {
+        if (settings.streamed) {
+            // 压缩纹理读取失败或格式不受支持时，在同一个后台任务中退回解码原图
+            bool mipmaps = settings.mipmaps;
+            texture = textureStreamer.request(workerPool().submit([compressed, path, mipmaps]() {
+                MipChainPtr chain = loadCompressedMipChain(compressed, mipmaps);
+                return chain->levels.empty() ? buildMipChain(decodeImage(path), mipmaps) : chain;
+            }).share(), settings, path);
+            insert(key, texture);
+            return texture;
+        }
+
+        Ktx2Texture image;
+        if (readKtx2(compressed, image) && image.layers == 0 && image.faces == 1)
+            texture = createKtx2Texture(image, settings, compressed);
+        if (texture) {
+            insert(key, texture);
+            return texture;
+        }
+    }
+
+    if (settings.streamed) {
+        std::shared_future<DecodedImagePtr> pending = takeImageAsync(path);
+        if (!pending.valid())
+            pending = workerPool().submit([path]() { return decodeImage(path); }).share();
+        texture = textureStreamer.request(pending, settings, path);
+        insert(key, texture);
+        return texture;
+    }
+
+    DecodedImagePtr image = takeImage(path);
+    if (!image->pixels) {
+        std::cerr << "Failed to load texture: " << path << std::endl;
+        return 0;
+    }
+
+    GLenum format = formatForChannels(image->channels);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image->width, image->height, 0, format, GL_UNSIGNED_BYTE, image->pixels);
+    if (settings.mipmaps)
+        glGenerateMipmap(GL_TEXTURE_2D); // **生成 MIP Maps**
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, settings.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, settings.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, settings.minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, settings.magFilter);
+
+    insert(key, texture);
+    return texture;
+}
+
+GLuint TextureCache::acquireCubeMap(const std::vector<std::string>& faces) {
+    std::string key = "cube";
+    for (size_t i = 0; i < faces.size(); i++)
+        key += "|" + canonicalPath(faces[i]);
+
+    GLuint texture = lookup(key);
+    if (texture)
+        return texture;
+
+    texture = createCompressedCubeMap(faces);
+    if (texture) {
+        insert(key, texture);
+        return texture;
+    }
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // 加载6个面的图片
+    for (unsigned int i = 0; i < faces.size(); i++) {
+        DecodedImagePtr image = takeImage(faces[i]);
+        if (image->pixels) {
+            GLenum format = formatForChannels(image->channels);
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                0, format, image->width, image->height, 0, format, GL_UNSIGNED_BYTE, image->pixels);
+        }
+        else {
+            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+        }
+    }
+
+    // 设置纹理参数
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    insert(key, texture);
+    return texture;
+}
+
+GLuint TextureCache::acquireKtx2(const std::string& path, const TextureSettings& settings) {
+    std::string key = "ktx2|" + canonicalPath(path) + settingsKey(settings);
+    GLuint texture = lookup(key);
+    if (texture)
+        return texture;
+
+    Ktx2Texture image;
+    if (!readKtx2(path, image))
+        return 0;
+    texture = createKtx2Texture(image, settings, path);
+    if (texture)
+        insert(key, texture);
+    return texture;
+}
+
+void TextureCache::release(GLuint texture) {
+    std::unordered_map<GLuint, std::string>::iterator it = keyByTexture.find(texture);
+    if (it == keyByTexture.end())
+        return;
+
+    Entry& entry = entries[it->second];
+    if (--entry.refCount > 0)
+        return;
+
+    textureStreamer.cancel(texture);
+    glDeleteTextures(1, &texture);
+    entries.erase(it->second);
+    keyByTexture.erase(it);
+}
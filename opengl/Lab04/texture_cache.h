@@ -0,0 +1,98 @@
+﻿#ifndef _TEXTURE_CACHE_H_
+#define _TEXTURE_CACHE_H_
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <cstdint>
+
+// 采样/格式设置：同一文件用不同设置加载会得到不同的纹理
+struct TextureSettings {
+    GLenum wrap = GL_REPEAT;
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    bool mipmaps = true;
+    bool streamed = false;  // 通过 TextureStreamer 分帧上传，先返回占位纹理
+};
+
+// 解码后的图片（CPU 内存）
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    unsigned char* pixels = nullptr;
+
+    DecodedImage() {}
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage& operator=(const DecodedImage&) = delete;
+    ~DecodedImage();
+};
+
+typedef std::shared_ptr<DecodedImage> DecodedImagePtr;
+
+// 读取并解码图片文件（线程安全，失败时 pixels 为空）
+DecodedImagePtr decodeImage(const std::string& path);
+
+// 加载图片时优先使用旁边同名的 .ktx2（TexCompress 生成的 BCn 压缩纹理），--no-compressed-textures 关闭
+extern bool compressedTexturesEnabled;
+
+// 图片对应的压缩纹理路径（X.jpg -> X.ktx2），未启用或文件不存在时返回空串
+std::string compressedTexturePath(const std::string& path);
+
+// KTX2 格式对应的 OpenGL 内部格式与像素格式（压缩格式的 format 为 0），当前上下文不支持时返回 false
+bool glFormatForKtx2(uint32_t vkFormat, GLenum& internalFormat, GLenum& format);
+
+// 按规范化路径 + 设置缓存的纹理，引用计数归零时删除 GPU 纹理
+class TextureCache {
+public:
+    // 加载（或复用）2D 纹理，失败返回 0。有压缩纹理时直接上传其中的 BCn 数据与 MIP 链
+    GLuint acquire2D(const std::string& path, const TextureSettings& settings = TextureSettings());
+
+    // 加载（或复用）立方体贴图，faces 依次为 +X -X +Y -Y +Z -Z。六个面都有压缩纹理时使用压缩格式
+    GLuint acquireCubeMap(const std::vector<std::string>& faces);
+
+    // 加载（或复用）KTX2 文件：按文件中的层数/面数创建 2D、数组或立方体纹理，
+    // 逐级上传文件自带的 MIP 链（不调用 glGenerateMipmap），失败返回 0
+    GLuint acquireKtx2(const std::string& path, const TextureSettings& settings = TextureSettings());
+
+    // 释放一次引用
+    void release(GLuint texture);
+
+    // 在线程池中提前读取并解码图片，之后的 acquire 只需上传（可从任意线程调用）
+    void prefetch2D(const std::string& path);
+    void prefetchCubeMap(const std::vector<std::string>& faces);
+
+    // 丢弃没有被 acquire 取走的预取结果
+    void dropPrefetched();
+
+    size_t textureCount() const { return entries.size(); }
+
+private:
+    struct Entry {
+        GLuint texture = 0;
+        int refCount = 0;
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<GLuint, std::string> keyByTexture;
+
+    std::mutex pendingMutex;
+    std::unordered_map<std::string, std::shared_future<DecodedImagePtr>> pendingImages; // 按规范化路径
+
+    DecodedImagePtr takeImage(const std::string& path);
+    std::shared_future<DecodedImagePtr> takeImageAsync(const std::string& path);
+
+    GLuint lookup(const std::string& key);
+    void insert(const std::string& key, GLuint texture);
+};
+
+// 规范化路径（绝对路径、统一分隔符），文件不存在时返回原路径
+std::string canonicalPath(const std::string& path);
+
+extern TextureCache textureCache;
+
+#endif
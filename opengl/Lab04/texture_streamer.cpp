@@ -0,0 +1,315 @@
+﻿#include "texture_streamer.h"
+#include "thread_pool.h"
+#include "ktx2.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+TextureStreamer textureStreamer;
+
+
+static GLenum formatForChannels(int channels) {
+    if (channels == 1)
+        return GL_RED;
+    if (channels == 4)
+        return GL_RGBA;
+    return GL_RGB;
+}
+
+MipChainPtr buildMipChain(const DecodedImagePtr& image, bool mipmaps) {
+    MipChainPtr chain = std::make_shared<MipChain>();
+    if (!image || !image->pixels)
+        return chain;
+
+    int width = image->width, height = image->height, channels = image->channels;
+    chain->channels = channels;
+    chain->widths.push_back(width);
+    chain->heights.push_back(height);
+    chain->levels.push_back(std::vector<unsigned char>(image->pixels, image->pixels + (size_t)width * height * channels));
+
+    while (mipmaps && (width > 1 || height > 1)) {
+        const std::vector<unsigned char>& source = chain->levels.back();
+        int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+        std::vector<unsigned char> level((size_t)nextWidth * nextHeight * channels);
+
+        // 2x2 盒式滤波，奇数尺寸时最后一行/列被钳制到边缘
+        for (int y = 0; y < nextHeight; y++) {
+            int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < nextWidth; x++) {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < channels; c++) {
+                    int sum = source[((size_t)y0 * width + x0) * channels + c] + source[((size_t)y0 * width + x1) * channels + c] +
+                              source[((size_t)y1 * width + x0) * channels + c] + source[((size_t)y1 * width + x1) * channels + c];
+                    level[((size_t)y * nextWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+
+        width = nextWidth;
+        height = nextHeight;
+        chain->widths.push_back(width);
+        chain->heights.push_back(height);
+        chain->levels.push_back(std::move(level));
+    }
+    return chain;
+}
+
+
+MipChainPtr loadCompressedMipChain(const std::string& path, bool mipmaps) {
+    MipChainPtr chain = std::make_shared<MipChain>();
+    Ktx2Texture image;
+    Ktx2FormatInfo info;
+    GLenum internalFormat, format;
+    if (!readKtx2(path, image) || image.layers != 0 || image.faces != 1 || !ktx2FormatInfo(image.vkFormat, info) ||
+        !info.compressed || !glFormatForKtx2(image.vkFormat, internalFormat, format))
+        return chain;
+
+    chain->compressedFormat = internalFormat;
+    chain->blockBytes = info.blockBytes;
+    chain->channels = info.channels;
+    size_t levelCount = mipmaps ? image.levels.size() : 1;
+    for (size_t level = 0; level < levelCount; level++) {
+        chain->widths.push_back(image.levelWidth((int)level));
+        chain->heights.push_back(image.levelHeight((int)level));
+        chain->levels.push_back(std::move(image.levels[level]));
+    }
+    return chain;
+}
+
+
+TextureStreamer::~TextureStreamer() {
+    // 退出时 GL 上下文可能已经销毁，这里只等待后台任务，GL 资源由 shutdown 释放
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].pending.valid())
+            jobs[i].pending.wait();
+    }
+}
+
+void TextureStreamer::setFrameBudget(size_t bytes) {
+    frameBudget = std::max(bytes, (size_t)64 * 1024); // 至少能放下一行 16K 宽的 RGBA
+}
+
+GLuint TextureStreamer::request(const std::shared_future<DecodedImagePtr>& image, const TextureSettings& settings, const std::string& name) {
+    bool mipmaps = settings.mipmaps;
+    std::shared_future<DecodedImagePtr> decoded = image;
+    // 解码任务总是先于这里提交（或已完成），线程池按提交顺序执行，等待不会死锁
+    return request(workerPool().submit([decoded, mipmaps]() { return buildMipChain(decoded.get(), mipmaps); }).share(), settings, name);
+}
+
+GLuint TextureStreamer::request(const std::shared_future<MipChainPtr>& mips, const TextureSettings& settings, const std::string& name) {
+    // 占位：1x1 中性灰，完整的单级纹理，可以立即采样
+    static const unsigned char placeholder[4] = { 128, 128, 128, 255 };
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, settings.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, settings.wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    Job job;
+    job.texture = texture;
+    job.settings = settings;
+    job.name = name;
+    job.pending = mips;
+    jobs.push_back(job);
+    return texture;
+}
+
+void TextureStreamer::cancel(GLuint texture) {
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].texture == texture) {
+            jobs.erase(jobs.begin() + i);
+            return;
+        }
+    }
+}
+
+void TextureStreamer::createRing() {
+    GLsizeiptr size = (GLsizeiptr)(frameBudget * RING_SEGMENTS);
+    glGenBuffers(1, &ringBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        persistentPointer = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    }
+    else {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void TextureStreamer::update() {
+    step(false);
+}
+
+void TextureStreamer::finish() {
+    while (!jobs.empty()) {
+        for (size_t i = 0; i < jobs.size(); i++) {
+            if (jobs[i].pending.valid())
+                jobs[i].pending.wait();
+        }
+        step(true);
+    }
+}
+
+// 上传一帧的份额；block 为 false 时若 GPU 仍在读取本段环形缓冲则直接跳过，保证帧时间平稳
+bool TextureStreamer::step(bool block) {
+    if (jobs.empty())
+        return false;
+    if (!ringBuffer)
+        createRing();
+
+    int segment = frameIndex % RING_SEGMENTS;
+    if (segmentFences[segment]) {
+        GLenum result = glClientWaitSync(segmentFences[segment], block ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                         block ? 1000000000ull : 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(segmentFences[segment]);
+        segmentFences[segment] = 0;
+    }
+
+    size_t segmentOffset = (size_t)segment * frameBudget;
+    unsigned char* destination = persistentPointer ? persistentPointer + segmentOffset : nullptr;
+    if (!destination) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+        destination = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, segmentOffset, frameBudget,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!destination) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return false;
+        }
+    }
+
+    std::vector<Upload> uploads;
+    std::vector<size_t> newlyAllocated;
+    size_t used = 0;
+
+    for (size_t j = 0; j < jobs.size() && used < frameBudget; j++) {
+        Job& job = jobs[j];
+        if (!job.mips) {
+            // 新纹理至少要能在本帧传完最小的几级，否则分配后会留下未定义内容
+            if (frameBudget - used < 1024 || job.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                continue;
+            job.mips = job.pending.get();
+            job.pending = std::shared_future<MipChainPtr>();
+            if (job.mips->levels.empty()) {
+                std::cerr << "Failed to load texture: " << job.name << std::endl;
+                job.level = -1; // 保留占位纹理
+                continue;
+            }
+            job.level = (int)job.mips->levels.size() - 1;
+            job.row = 0;
+            newlyAllocated.push_back(j);
+        }
+
+        const MipChain& mips = *job.mips;
+        while (job.level >= 0 && used < frameBudget) {
+            int width = mips.widths[job.level], height = mips.heights[job.level];
+            int rowCount = mips.rowCount(job.level);
+            size_t rowBytes = mips.rowBytes(job.level);
+            int rows = std::min(rowCount - job.row, (int)((frameBudget - used) / rowBytes));
+            if (rows <= 0)
+                break;
+
+            memcpy(destination + used, &mips.levels[job.level][job.row * rowBytes], rows * rowBytes);
+
+            // 压缩格式的一行是 4 行像素，最后一行块可能不足 4 行
+            int pixelRow = mips.compressedFormat ? job.row * 4 : job.row;
+            Upload upload;
+            upload.texture = job.texture;
+            upload.level = job.level;
+            upload.y = pixelRow;
+            upload.width = width;
+            upload.rows = mips.compressedFormat ? std::min(rows * 4, height - pixelRow) : rows;
+            upload.format = mips.compressedFormat ? mips.compressedFormat : formatForChannels(mips.channels);
+            upload.compressed = mips.compressedFormat != 0;
+            upload.offset = segmentOffset + used;
+            upload.bytes = rows * rowBytes;
+            upload.levelComplete = job.row + rows == rowCount;
+            uploads.push_back(upload);
+
+            used += rows * rowBytes;
+            job.row += rows;
+            if (upload.levelComplete) {
+                job.level--;
+                job.row = 0;
+            }
+        }
+    }
+
+    if (!persistentPointer)
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // 分配完整的 MIP 存储（不绑定 PBO，否则空指针会被当作缓冲偏移），最小一级随后在同一帧上传
+    for (size_t i = 0; i < newlyAllocated.size(); i++) {
+        const Job& job = jobs[newlyAllocated[i]];
+        const MipChain& mips = *job.mips;
+        GLenum format = formatForChannels(mips.channels);
+        int maxLevel = (int)mips.levels.size() - 1;
+
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        for (int level = 0; level <= maxLevel; level++) {
+            if (mips.compressedFormat)
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, mips.compressedFormat, mips.widths[level], mips.heights[level], 0,
+                                       (GLsizei)mips.levels[level].size(), nullptr);
+            else
+                glTexImage2D(GL_TEXTURE_2D, level, format, mips.widths[level], mips.heights[level], 0, format, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, maxLevel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, job.settings.mipmaps ? job.settings.minFilter : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, job.settings.magFilter);
+    }
+
+    if (!uploads.empty()) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (size_t i = 0; i < uploads.size(); i++) {
+            const Upload& upload = uploads[i];
+            glBindTexture(GL_TEXTURE_2D, upload.texture);
+            if (upload.compressed)
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.y, upload.width, upload.rows,
+                                          upload.format, (GLsizei)upload.bytes, (const void*)upload.offset);
+            else
+                glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.y, upload.width, upload.rows,
+                                upload.format, GL_UNSIGNED_BYTE, (const void*)upload.offset);
+            // 整级到达后才允许采样它
+            if (upload.levelComplete)
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, upload.level);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        segmentFences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    frameIndex++;
+
+    // 移除已完成（或加载失败）的任务
+    for (size_t j = jobs.size(); j-- > 0;) {
+        if (!jobs[j].pending.valid() && jobs[j].level < 0)
+            jobs.erase(jobs.begin() + j);
+    }
+    return !uploads.empty();
+}
+
+void TextureStreamer::shutdown() {
+    for (int i = 0; i < RING_SEGMENTS; i++) {
+        if (segmentFences[i])
+            glDeleteSync(segmentFences[i]);
+        segmentFences[i] = 0;
+    }
+    if (ringBuffer) {
+        if (persistentPointer) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ringBuffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &ringBuffer);
+    }
+    ringBuffer = 0;
+    persistentPointer = nullptr;
+    jobs.clear();
+}
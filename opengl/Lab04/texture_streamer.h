@@ -0,0 +1,101 @@
+﻿#ifndef _TEXTURE_STREAMER_H_
+#define _TEXTURE_STREAMER_H_
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include "texture_cache.h"
+
+// 后台线程中生成的完整 MIP 链（level 0 为原图）
+struct MipChain {
+    int channels = 0;
+    GLenum compressedFormat = 0;    // 非 0 时各级为 4x4 块压缩数据，按块行存放
+    int blockBytes = 0;
+    std::vector<int> widths, heights;
+    std::vector<std::vector<unsigned char>> levels;
+
+    // 上传的最小单位为一行：未压缩为一行像素，压缩格式为一行 4x4 块
+    int rowCount(int level) const { return compressedFormat ? (heights[level] + 3) / 4 : heights[level]; }
+    size_t rowBytes(int level) const {
+        return compressedFormat ? (size_t)(widths[level] + 3) / 4 * blockBytes : (size_t)widths[level] * channels;
+    }
+};
+
+typedef std::shared_ptr<MipChain> MipChainPtr;
+
+// 用 2x2 盒式滤波生成 MIP 链（线程安全，解码失败时返回空链）
+MipChainPtr buildMipChain(const DecodedImagePtr& image, bool mipmaps);
+
+// 读取 TexCompress 生成的 BCn 压缩 KTX2（线程安全），文件无效或当前上下文不支持该格式时返回空链
+MipChainPtr loadCompressedMipChain(const std::string& path, bool mipmaps);
+
+// 流式纹理上传：解码与 MIP 生成在线程池中完成，GL 线程每帧只通过 PBO 环形缓冲上传
+// 不超过预算的字节数。MIP 从最小一级开始上传并逐步降低 GL_TEXTURE_BASE_LEVEL，
+// 纹理 ID 始终不变，上传完成前显示 1x1 占位色或已到达的低分辨率 MIP
+class TextureStreamer {
+public:
+    ~TextureStreamer();
+
+    // 每帧上传字节数上限（默认 4 MB），需在第一次 update 之前设置
+    void setFrameBudget(size_t bytes);
+
+    // 创建带占位内容的纹理并排队上传，立即返回纹理 ID
+    GLuint request(const std::shared_future<DecodedImagePtr>& image, const TextureSettings& settings, const std::string& name);
+
+    // 同上，MIP 链由调用者在后台生成（例如直接读取压缩纹理）
+    GLuint request(const std::shared_future<MipChainPtr>& mips, const TextureSettings& settings, const std::string& name);
+
+    // 取消尚未完成的上传（纹理本身由调用者删除）
+    void cancel(GLuint texture);
+
+    // 每帧调用一次：收取后台结果，并在预算内上传
+    void update();
+
+    // 等待并上传全部排队的纹理（无窗口渲染在第一帧之前调用，保证输出确定）
+    void finish();
+
+    bool busy() const { return !jobs.empty(); }
+
+    // 释放 PBO 与同步对象（需要有效的 GL 上下文）
+    void shutdown();
+
+private:
+    struct Job {
+        GLuint texture = 0;
+        TextureSettings settings;
+        std::string name;
+        std::shared_future<MipChainPtr> pending;
+        MipChainPtr mips;
+        int level = -1;     // 正在上传的 MIP 级别，从最小一级递减到 0
+        int row = 0;        // 当前级别已上传的行数
+    };
+
+    // 一次 glTexSubImage2D（压缩格式为 glCompressedTexSubImage2D）：PBO 中 offset 处的若干行像素
+    struct Upload {
+        GLuint texture;
+        int level;
+        int y, width, rows;
+        GLenum format;
+        bool compressed;
+        size_t offset, bytes;
+        bool levelComplete;
+    };
+
+    static const int RING_SEGMENTS = 3;
+
+    std::vector<Job> jobs;
+    size_t frameBudget = 4 * 1024 * 1024;
+    GLuint ringBuffer = 0;
+    unsigned char* persistentPointer = nullptr; // 持久映射（GL_ARB_buffer_storage），否则每帧 glMapBufferRange
+    GLsync segmentFences[RING_SEGMENTS] = {};
+    unsigned frameIndex = 0;
+
+    void createRing();
+    bool step(bool block);
+};
+
+extern TextureStreamer textureStreamer;
+
+#endif
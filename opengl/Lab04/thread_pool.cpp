@@ -0,0 +1,88 @@
+﻿#include "thread_pool.h"
+#include <atomic>
+
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 4;
+
+    for (unsigned i = 0; i < threadCount; i++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return; // stopping 且队列已清空
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (begin >= end)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    size_t chunkCount = (end - begin + grain - 1) / grain;
+    if (chunkCount == 1) {
+        body(begin, end);
+        return;
+    }
+
+    // 各线程（包括调用线程）从共享计数器领取区段；调用线程只等待区段完成而不等待辅助任务本身，
+    // 因此在工作线程内嵌套调用也不会死锁（未开始的辅助任务领不到区段会直接返回）
+    struct SharedState {
+        std::atomic<size_t> next{ 0 };
+        size_t done = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    std::shared_ptr<SharedState> state = std::make_shared<SharedState>();
+    const std::function<void(size_t, size_t)>* bodyPtr = &body;
+
+    auto runChunks = [state, bodyPtr, begin, end, grain, chunkCount]() {
+        for (size_t chunk = state->next++; chunk < chunkCount; chunk = state->next++) {
+            size_t first = begin + chunk * grain;
+            size_t last = first + grain < end ? first + grain : end;
+            (*bodyPtr)(first, last);
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (++state->done == chunkCount)
+                state->finished.notify_all();
+        }
+    };
+
+    size_t helpers = chunkCount - 1 < workers.size() ? chunkCount - 1 : workers.size();
+    for (size_t i = 0; i < helpers; i++)
+        submit(runChunks);
+
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done == chunkCount; });
+}
+
+ThreadPool& workerPool() {
+    static ThreadPool pool;
+    return pool;
+}
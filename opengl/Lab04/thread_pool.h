@@ -0,0 +1,53 @@
+﻿#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// 固定大小的工作线程池：submit 返回 future，任务按提交顺序执行
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = 0); // 0 表示使用全部硬件线程
+    ~ThreadPool();
+
+    // Result 按 packaged_task 的调用方式推导（对衰变后的副本做左值调用），不依赖 C++17 起弃用的 result_of
+    template <class F, class Result = decltype(std::declval<typename std::decay<F>::type&>()())>
+    std::future<Result> submit(F&& task) {
+        std::shared_ptr<std::packaged_task<Result()>> packaged =
+            std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back([packaged]() { (*packaged)(); });
+        }
+        wake.notify_one();
+        return future;
+    }
+
+    // 把 [begin, end) 切成若干段并行执行 body(first, last)，调用线程也参与计算，返回时全部完成
+    void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    unsigned threadCount() const { return (unsigned)workers.size(); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void workerLoop();
+};
+
+// 全局工作线程池（首次使用时创建）
+ThreadPool& workerPool();
+
+#endif
@@ -0,0 +1,257 @@
+﻿#include "hatching.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// 一笔排线：位置与长度相对纹理归一化（各级中长度比例相同），宽度以纹素计（各级相同）
+struct HatchStroke {
+    float x, y;
+    float length;
+    float angle;
+    float width;
+    float darkness;
+};
+
+// 某一色调某一级的墨量（0 为白纸，1 为全黑）
+struct InkLevel {
+    int size = 0;
+    std::vector<float> ink;
+    double total = 0.0;
+
+    double mean() const { return total / ((double)size * size); }
+};
+
+
+// 对笔画覆盖的每个纹素调用 visit(下标, 覆盖率)，纹理在两个方向上平铺
+template <class Visit>
+static void rasterizeStroke(const HatchStroke& stroke, int size, Visit visit) {
+    float centerX = stroke.x * size, centerY = stroke.y * size;
+    float halfLength = stroke.length * size * 0.5f;
+    float dirX = std::cos(stroke.angle), dirY = std::sin(stroke.angle);
+    float reach = stroke.width * 0.5f + 1.0f;
+
+    int minX = (int)std::floor(centerX - std::abs(dirX) * halfLength - reach);
+    int maxX = (int)std::ceil(centerX + std::abs(dirX) * halfLength + reach);
+    int minY = (int)std::floor(centerY - std::abs(dirY) * halfLength - reach);
+    int maxY = (int)std::ceil(centerY + std::abs(dirY) * halfLength + reach);
+    maxX = std::min(maxX, minX + size - 1);
+    maxY = std::min(maxY, minY + size - 1);
+
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            float offsetX = x + 0.5f - centerX, offsetY = y + 0.5f - centerY;
+            float along = offsetX * dirX + offsetY * dirY;
+            float clamped = std::max(-halfLength, std::min(halfLength, along));
+            float distance = std::sqrt((offsetX - clamped * dirX) * (offsetX - clamped * dirX) +
+                                       (offsetY - clamped * dirY) * (offsetY - clamped * dirY));
+            // 抗锯齿边缘，两端各用一个笔宽逐渐变细
+            float coverage = std::min(1.0f, std::max(0.0f, stroke.width * 0.5f + 0.5f - distance));
+            float taper = std::min(1.0f, (halfLength - std::abs(along)) / stroke.width + 1.0f);
+            coverage *= std::max(0.0f, taper) * stroke.darkness;
+            if (coverage <= 0.0f)
+                continue;
+            int wrappedX = ((x % size) + size) % size, wrappedY = ((y % size) + size) % size;
+            visit((size_t)wrappedY * size + wrappedX, coverage);
+        }
+    }
+}
+
+// 笔画叠加在 [0, level] 各级上带来的平均墨量增量之和，越大说明与已有笔画重叠越少
+static double strokeGain(const HatchStroke& stroke, const std::vector<InkLevel>& levels, int level) {
+    double gain = 0.0;
+    for (int l = 0; l <= level; l++) {
+        const InkLevel& target = levels[l];
+        double levelGain = 0.0;
+        rasterizeStroke(stroke, target.size, [&](size_t index, float coverage) {
+            levelGain += (1.0 - target.ink[index]) * coverage;
+        });
+        gain += levelGain / ((double)target.size * target.size);
+    }
+    return gain;
+}
+
+static void applyStroke(const HatchStroke& stroke, std::vector<InkLevel>& levels, int level) {
+    for (int l = 0; l <= level; l++) {
+        InkLevel& target = levels[l];
+        rasterizeStroke(stroke, target.size, [&](size_t index, float coverage) {
+            float before = target.ink[index];
+            float after = before + (1.0f - before) * coverage;
+            target.ink[index] = after;
+            target.total += after - before;
+        });
+    }
+}
+
+static float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value) {
+    value = std::min(1.0f, std::max(0.0f, value));
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+void generateHatchingTones(const HatchingSettings& settings, HatchingTones& tones) {
+    int strokeLevels = 1;
+    while (strokeLevels < settings.strokeLevels && (settings.size >> strokeLevels) >= 4)
+        strokeLevels++;
+
+    std::vector<InkLevel> current(strokeLevels);
+    for (int l = 0; l < strokeLevels; l++) {
+        current[l].size = settings.size >> l;
+        current[l].ink.assign((size_t)current[l].size * current[l].size, 0.0f);
+    }
+
+    std::mt19937 random(settings.seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<HatchStroke> candidates(settings.candidates);
+    std::vector<double> gains(settings.candidates);
+    const float pi = 3.14159265f;
+
+    tones.assign(settings.tones + 1, std::vector<std::vector<float> >());
+    for (int tone = 0; tone <= settings.tones; tone++) {
+        if (tone > 0) {
+            // 深色调在浅色调的基础上继续加笔画；后一半色调加入交叉排线
+            float targetInk = 0.9f * tone / settings.tones;
+            float baseAngle = tone * 2 > settings.tones + 1 ? pi * 0.5f : 0.0f;
+
+            // 从最粗的级别开始，放在第 l 级的笔画同时画进所有更精细的级别
+            for (int level = strokeLevels - 1; level >= 0; level--) {
+                for (int guard = 0; current[level].mean() < targetInk && guard < 100000; guard++) {
+                    for (HatchStroke& stroke : candidates) {
+                        stroke.x = unit(random);
+                        stroke.y = unit(random);
+                        stroke.length = 0.3f + 0.3f * unit(random);
+                        stroke.angle = baseAngle + (unit(random) - 0.5f) * 0.3f;
+                        stroke.width = 1.2f + 0.6f * unit(random);
+                        stroke.darkness = 0.6f + 0.3f * unit(random);
+                    }
+                    workerPool().parallelFor(0, candidates.size(), 4, [&](size_t first, size_t last) {
+                        for (size_t k = first; k < last; k++)
+                            gains[k] = strokeGain(candidates[k], current, level);
+                    });
+                    size_t best = std::max_element(gains.begin(), gains.end()) - gains.begin();
+                    applyStroke(candidates[best], current, level);
+                }
+            }
+        }
+
+        // 墨水覆盖率是线性光下的遮挡比例，编码成 sRGB 后与下采样得到的级别处在同一空间，
+        // 各级平均亮度（线性光）因此一致
+        for (int level = 0; level < strokeLevels; level++) {
+            const std::vector<float>& ink = current[level].ink;
+            std::vector<float> brightness(ink.size());
+            for (size_t i = 0; i < ink.size(); i++)
+                brightness[i] = linearToSrgb(1.0f - ink[i]);
+            tones[tone].push_back(std::move(brightness));
+        }
+    }
+}
+
+
+// 零阶第一类修正贝塞尔函数（级数展开）
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x * 0.5 / k) * (x * 0.5 / k);
+        sum += term;
+    }
+    return sum;
+}
+
+// 2 倍下采样的一维权重：目标纹素中心在源纹素 2x 与 2x + 1 之间，tap 为相对 2x 的偏移
+static std::vector<std::pair<int, float> > downsampleTaps(MipFilter filter) {
+    std::vector<std::pair<int, float> > taps;
+    if (filter == MIP_FILTER_BOX) {
+        taps.push_back(std::make_pair(0, 0.5f));
+        taps.push_back(std::make_pair(1, 0.5f));
+        return taps;
+    }
+
+    // 半带 sinc 乘以半径 3 个源纹素的 Kaiser 窗（alpha = 4）
+    const double radius = 3.0, alpha = 4.0, pi = 3.14159265358979;
+    double total = 0.0;
+    for (int tap = -2; tap <= 3; tap++) {
+        double distance = tap - 0.5;
+        double x = distance * 0.5;
+        double sinc = std::sin(pi * x) / (pi * x);
+        double t = distance / radius;
+        double window = besselI0(alpha * std::sqrt(std::max(0.0, 1.0 - t * t))) / besselI0(alpha);
+        taps.push_back(std::make_pair(tap, (float)(sinc * window)));
+        total += sinc * window;
+    }
+    for (size_t i = 0; i < taps.size(); i++)
+        taps[i].second = (float)(taps[i].second / total);
+    return taps;
+}
+
+// 线性空间中可分离地下采样一级（平铺寻址）
+static std::vector<float> downsample(const std::vector<float>& source, int size, const std::vector<std::pair<int, float> >& taps) {
+    int half = std::max(1, size / 2);
+    std::vector<float> rows((size_t)size * half), result((size_t)half * half);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < half; x++) {
+            float sum = 0.0f;
+            for (size_t t = 0; t < taps.size(); t++)
+                sum += taps[t].second * source[(size_t)y * size + ((2 * x + taps[t].first) % size + size) % size];
+            rows[(size_t)y * half + x] = sum;
+        }
+    }
+    for (int y = 0; y < half; y++) {
+        for (int x = 0; x < half; x++) {
+            float sum = 0.0f;
+            for (size_t t = 0; t < taps.size(); t++)
+                sum += taps[t].second * rows[(size_t)(((2 * y + taps[t].first) % size + size) % size) * half + x];
+            result[(size_t)y * half + x] = sum;
+        }
+    }
+    return result;
+}
+
+void buildMipChains(const HatchingSettings& settings, HatchingTones& tones) {
+    std::vector<std::pair<int, float> > taps = downsampleTaps(settings.filter);
+
+    workerPool().parallelFor(0, tones.size(), 1, [&](size_t first, size_t last) {
+        for (size_t tone = first; tone < last; tone++) {
+            std::vector<std::vector<float> >& levels = tones[tone];
+            int size = settings.size >> (levels.size() - 1);
+            std::vector<float> linear(levels.back().size());
+            for (size_t i = 0; i < linear.size(); i++)
+                linear[i] = srgbToLinear(levels.back()[i]);
+
+            while (size > 1) {
+                linear = downsample(linear, size, taps);
+                size /= 2;
+                std::vector<float> encoded(linear.size());
+                for (size_t i = 0; i < linear.size(); i++)
+                    encoded[i] = linearToSrgb(linear[i]);
+                levels.push_back(std::move(encoded));
+            }
+        }
+    });
+}
+
+Ktx2Texture packTonalArtMap(const HatchingSettings& settings, const HatchingTones& tones) {
+    Ktx2Texture texture;
+    texture.vkFormat = KTX2_FORMAT_R8G8_UNORM;
+    texture.width = texture.height = settings.size;
+    texture.layers = settings.tones;
+
+    // 第 i 层 R = 色调 i，G = 色调 i + 1
+    for (size_t level = 0; level < tones[0].size(); level++) {
+        size_t texels = tones[0][level].size();
+        std::vector<uint8_t> data(texels * 2 * settings.tones);
+        for (int layer = 0; layer < settings.tones; layer++) {
+            uint8_t* out = &data[texels * 2 * layer];
+            const std::vector<float>& lighter = tones[layer][level];
+            const std::vector<float>& darker = tones[layer + 1][level];
+            for (size_t i = 0; i < texels; i++) {
+                out[i * 2] = (uint8_t)std::lround(lighter[i] * 255.0f);
+                out[i * 2 + 1] = (uint8_t)std::lround(darker[i] * 255.0f);
+            }
+        }
+        texture.levels.push_back(std::move(data));
+    }
+    return texture;
+}
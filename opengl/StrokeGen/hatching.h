@@ -0,0 +1,42 @@
+﻿#ifndef _HATCHING_H_
+#define _HATCHING_H_
+
+#include <vector>
+#include <cstdint>
+#include "ktx2.h"
+
+// 色调艺术图（Tonal Art Map，Praun 等 2001）：一组由浅到深的排线色调，每级色调带自己的 MIP 链。
+// 深色调包含所有浅色调的笔画（色调嵌套），粗糙级别的笔画也出现在所有更精细的级别（分辨率嵌套），
+// 因此远处与近处、相邻色调之间的过渡都不会闪烁。
+//
+// 输出为 RG8 数组纹理：第 i 层的 R 为色调 i、G 为色调 i + 1（色调 0 为白纸），
+// 着色器一次 texture() 取得相邻两级色调并插值
+
+// 放置笔画的级别之后，更小的 MIP 由上一级下采样得到
+enum MipFilter {
+    MIP_FILTER_BOX,     // 2x2 平均
+    MIP_FILTER_KAISER,  // 6 阶 Kaiser 窗 sinc，更锐利且不易混叠
+};
+
+struct HatchingSettings {
+    int size = 256;             // 第 0 级边长（2 的幂）
+    int tones = 6;              // 排线色调数（不含白纸）
+    int strokeLevels = 5;       // 逐级放置笔画的 MIP 级数（256 到 16），1 表示只画第 0 级、其余全部滤波
+    int candidates = 64;        // 每放一笔比较的候选笔画数
+    uint32_t seed = 1;
+    MipFilter filter = MIP_FILTER_KAISER;
+};
+
+// tones[t][l]：色调 t 第 l 级的亮度（0 黑 1 白，按 sRGB 编码的显示值；墨水覆盖率按线性光换算），t = 0 为白纸
+typedef std::vector<std::vector<std::vector<float> > > HatchingTones;
+
+// 放置笔画，生成 [0, strokeLevels) 各级。候选笔画的评估在工作线程池中并行
+void generateHatchingTones(const HatchingSettings& settings, HatchingTones& tones);
+
+// 在已有级别之后补齐到 1x1：先解码到线性空间再滤波，纹理按平铺处理。各色调并行
+void buildMipChains(const HatchingSettings& settings, HatchingTones& tones);
+
+// 打包为 KTX2 的 RG8 数组纹理
+Ktx2Texture packTonalArtMap(const HatchingSettings& settings, const HatchingTones& tones);
+
+#endif
@@ -0,0 +1,89 @@
+﻿#include "hatching.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+
+// 离线生成排线色调艺术图，写成一个 KTX2 数组纹理（含完整 MIP 链），运行时一次上传、不再 glGenerateMipmap
+//
+// StrokeGen [-o hatching.ktx2] [--size N] [--tones N] [--stroke-levels N] [--candidates N] [--seed N] [--filter box|kaiser]
+
+static void printUsage() {
+    std::cerr << "Usage: StrokeGen [-o FILE] [--size N] [--tones N] [--stroke-levels N] [--candidates N] [--seed N] [--filter box|kaiser]" << std::endl;
+}
+
+static bool isPowerOfTwo(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+int main(int argc, char** argv) {
+    HatchingSettings settings;
+    std::string outputFile = "hatching.ktx2";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if ((arg == "-o" || arg == "--out") && hasValue) {
+            outputFile = argv[++i];
+        }
+        else if (arg == "--size" && hasValue) {
+            settings.size = atoi(argv[++i]);
+        }
+        else if (arg == "--tones" && hasValue) {
+            settings.tones = atoi(argv[++i]);
+        }
+        else if (arg == "--stroke-levels" && hasValue) {
+            settings.strokeLevels = atoi(argv[++i]);
+        }
+        else if (arg == "--candidates" && hasValue) {
+            settings.candidates = atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && hasValue) {
+            settings.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--filter" && hasValue) {
+            std::string filter = argv[++i];
+            if (filter == "box")
+                settings.filter = MIP_FILTER_BOX;
+            else if (filter == "kaiser")
+                settings.filter = MIP_FILTER_KAISER;
+            else {
+                std::cerr << "Unknown --filter: " << filter << std::endl;
+                return 1;
+            }
+        }
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (!isPowerOfTwo(settings.size) || settings.tones <= 0 || settings.strokeLevels <= 0 || settings.candidates <= 0) {
+        std::cerr << "Invalid settings: size must be a power of two, counts must be positive" << std::endl;
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    HatchingTones tones;
+    generateHatchingTones(settings, tones);
+    std::chrono::steady_clock::time_point strokesDone = std::chrono::steady_clock::now();
+
+    buildMipChains(settings, tones);
+    Ktx2Texture texture = packTonalArtMap(settings, tones);
+    std::chrono::steady_clock::time_point filterDone = std::chrono::steady_clock::now();
+
+    if (!writeKtx2(outputFile, texture, "StrokeGen"))
+        return 1;
+
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+    std::cout << "Wrote " << outputFile << ": " << settings.size << "x" << settings.size << ", "
+              << settings.tones << " layers, " << texture.levels.size() << " levels" << std::endl;
+    std::cout << "Strokes " << Milliseconds(strokesDone - start).count() << " ms, mip filtering "
+              << Milliseconds(filterDone - strokesDone).count() << " ms ("
+              << (settings.filter == MIP_FILTER_BOX ? "box" : "kaiser") << "), "
+              << workerPool().threadCount() << " worker threads" << std::endl;
+    return 0;
+}
@@ -0,0 +1,409 @@
+﻿#include "bc_encoder.h"
+#include "ktx2.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// 块内纹素的浮点颜色
+struct BlockColors {
+    float texels[16][4];
+};
+
+static void loadBlock(const uint8_t rgba[64], BlockColors& block) {
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            block.texels[i][c] = rgba[i * 4 + c];
+}
+
+// 前 channels 个通道的主轴（协方差矩阵幂迭代），返回均值与单位方向
+static void principalAxis(const BlockColors& block, int channels, float mean[4], float axis[4]) {
+    float covariance[4][4] = {};
+    for (int c = 0; c < 4; c++)
+        mean[c] = 0.0f;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < channels; c++)
+            mean[c] += block.texels[i][c] / 16.0f;
+    for (int i = 0; i < 16; i++) {
+        for (int a = 0; a < channels; a++)
+            for (int b = 0; b < channels; b++)
+                covariance[a][b] += (block.texels[i][a] - mean[a]) * (block.texels[i][b] - mean[b]);
+    }
+
+    for (int c = 0; c < 4; c++)
+        axis[c] = c < channels ? 1.0f : 0.0f;
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < channels; a++) {
+            for (int b = 0; b < channels; b++)
+                next[a] += covariance[a][b] * axis[b];
+            length = std::max(length, std::abs(next[a]));
+        }
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < channels; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float length = 0.0f;
+    for (int c = 0; c < channels; c++)
+        length += axis[c] * axis[c];
+    length = std::sqrt(length);
+    for (int c = 0; c < channels; c++)
+        axis[c] = length > 0.0f ? axis[c] / length : 0.0f;
+}
+
+// 沿主轴取投影的两端作为初始端点
+static void axisEndpoints(const BlockColors& block, int channels, float low[4], float high[4]) {
+    float mean[4], axis[4];
+    principalAxis(block, channels, mean, axis);
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channels; c++)
+            t += (block.texels[i][c] - mean[c]) * axis[c];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (int c = 0; c < 4; c++) {
+        low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minT));
+        high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxT));
+    }
+}
+
+// 已知每个纹素的插值权重（0 对应 low，1 对应 high）时，最小二乘求解两个端点
+static bool refineEndpoints(const BlockColors& block, int channels, const float weights[16], float low[4], float high[4]) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++) {
+        float b = weights[i], a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channels; c++) {
+            ax[c] += a * block.texels[i][c];
+            bx[c] += b * block.texels[i][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+        return false;
+    for (int c = 0; c < channels; c++) {
+        low[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / determinant));
+        high[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / determinant));
+    }
+    return true;
+}
+
+// 按位从低到高写入压缩块
+struct BitWriter {
+    uint8_t* out;
+    int position = 0;
+
+    explicit BitWriter(uint8_t* destination, int bytes) : out(destination) { memset(out, 0, bytes); }
+
+    void write(uint32_t value, int bits) {
+        for (int i = 0; i < bits; i++, position++) {
+            if (value >> i & 1)
+                out[position >> 3] |= (uint8_t)(1 << (position & 7));
+        }
+    }
+};
+
+
+// ---------------------------------------------------------------- BC1
+
+static uint16_t packRGB565(const float color[4]) {
+    int r = (int)std::lround(color[0] * 31.0f / 255.0f);
+    int g = (int)std::lround(color[1] * 63.0f / 255.0f);
+    int b = (int)std::lround(color[2] * 31.0f / 255.0f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static void unpackRGB565(uint16_t packed, int color[3]) {
+    int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+// 四色模式：索引 0 = color0，1 = color1，2、3 为 1/3、2/3 处的插值
+static const float kBC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+// 为给定端点选择索引，返回平方误差
+static int selectBC1Indices(const BlockColors& block, uint16_t color0, uint16_t color1, uint8_t indices[16]) {
+    int c0[3], c1[3], palette[4][3];
+    unpackRGB565(color0, c0);
+    unpackRGB565(color1, c1);
+    for (int c = 0; c < 3; c++) {
+        palette[0][c] = c0[c];
+        palette[1][c] = c1[c];
+        palette[2][c] = (2 * c0[c] + c1[c]) / 3;
+        palette[3][c] = (c0[c] + 2 * c1[c]) / 3;
+    }
+
+    int total = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0, bestError = 1 << 30;
+        for (int p = 0; p < 4; p++) {
+            int error = 0;
+            for (int c = 0; c < 3; c++) {
+                int d = (int)block.texels[i][c] - palette[p][c];
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                best = p;
+            }
+        }
+        indices[i] = (uint8_t)best;
+        total += bestError;
+    }
+    return total;
+}
+
+static void encodeBC1Colors(const BlockColors& block, uint8_t out[8]) {
+    float low[4], high[4];
+    axisEndpoints(block, 3, low, high);
+
+    uint16_t bestColor0 = 0, bestColor1 = 0;
+    uint8_t bestIndices[16] = {};
+    int bestError = 1 << 30;
+
+    // 主轴端点 + 两轮最小二乘修正，保留误差最小的一组
+    for (int iteration = 0; iteration < 3; iteration++) {
+        uint16_t color0 = packRGB565(high), color1 = packRGB565(low);
+        if (color0 < color1)
+            std::swap(color0, color1);
+        uint8_t indices[16];
+        int error = selectBC1Indices(block, color0, color1, indices);
+        if (error < bestError) {
+            bestError = error;
+            bestColor0 = color0;
+            bestColor1 = color1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+        if (color0 == color1)
+            break;
+
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+            weights[i] = kBC1Weights[indices[i]];
+        // 权重 0 对应 color0（较大的端点），用 low 承接
+        if (!refineEndpoints(block, 3, weights, low, high))
+            break;
+        std::swap(low, high);
+    }
+
+    // color0 > color1 才是四色模式；两者相等时所有索引为 0，两种模式解码结果相同
+    if (bestColor0 == bestColor1)
+        memset(bestIndices, 0, sizeof(bestIndices));
+
+    BitWriter writer(out, 8);
+    writer.write(bestColor0, 16);
+    writer.write(bestColor1, 16);
+    for (int i = 0; i < 16; i++)
+        writer.write(bestIndices[i], 2);
+}
+
+void encodeBC1(const uint8_t rgba[64], uint8_t out[8]) {
+    BlockColors block;
+    loadBlock(rgba, block);
+    encodeBC1Colors(block, out);
+}
+
+
+// ---------------------------------------------------------------- BC4（BC3 的 alpha、BC5 的两个通道）
+
+// 八值模式：endpoint0 > endpoint1，索引 0、1 为端点，2~7 为其间 6 个等分点
+static void encodeBC4Channel(const uint8_t rgba[64], int channel, uint8_t out[8]) {
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++) {
+        low = std::min(low, (int)rgba[i * 4 + channel]);
+        high = std::max(high, (int)rgba[i * 4 + channel]);
+    }
+
+    BitWriter writer(out, 8);
+    writer.write(high, 8);
+    writer.write(low, 8);
+    if (high == low) {
+        writer.write(0, 48);
+        return;
+    }
+
+    int palette[8] = { high, low };
+    for (int k = 1; k < 7; k++)
+        palette[k + 1] = ((7 - k) * high + k * low + 3) / 7;
+
+    for (int i = 0; i < 16; i++) {
+        int value = rgba[i * 4 + channel], best = 0;
+        for (int p = 1; p < 8; p++) {
+            if (std::abs(palette[p] - value) < std::abs(palette[best] - value))
+                best = p;
+        }
+        writer.write(best, 3);
+    }
+}
+
+void encodeBC3(const uint8_t rgba[64], uint8_t out[16]) {
+    BlockColors block;
+    loadBlock(rgba, block);
+    encodeBC4Channel(rgba, 3, out);
+    encodeBC1Colors(block, out + 8);
+}
+
+void encodeBC5(const uint8_t rgba[64], uint8_t out[16]) {
+    encodeBC4Channel(rgba, 0, out);
+    encodeBC4Channel(rgba, 1, out + 8);
+}
+
+
+// ---------------------------------------------------------------- BC7 模式 6
+
+static const int kBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// 端点量化为 7 位 + 共享 P 位（RGBA 四个通道共用），选择误差较小的 P 位
+static void quantizeBC7Endpoint(const float color[4], int quantized[4], int& pBit) {
+    float bestError = 1e30f;
+    for (int p = 0; p < 2; p++) {
+        int candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++) {
+            candidate[c] = std::min(127, std::max(0, (int)std::lround((color[c] - p) / 2.0f)));
+            float d = color[c] - (candidate[c] * 2 + p);
+            error += d * d;
+        }
+        if (error < bestError) {
+            bestError = error;
+            pBit = p;
+            memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+static int selectBC7Indices(const BlockColors& block, const int endpoint0[4], const int endpoint1[4], uint8_t indices[16]) {
+    int palette[16][4];
+    for (int k = 0; k < 16; k++)
+        for (int c = 0; c < 4; c++)
+            palette[k][c] = ((64 - kBC7Weights4[k]) * endpoint0[c] + kBC7Weights4[k] * endpoint1[c] + 32) >> 6;
+
+    int total = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0, bestError = 1 << 30;
+        for (int k = 0; k < 16; k++) {
+            int error = 0;
+            for (int c = 0; c < 4; c++) {
+                int d = (int)block.texels[i][c] - palette[k][c];
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                best = k;
+            }
+        }
+        indices[i] = (uint8_t)best;
+        total += bestError;
+    }
+    return total;
+}
+
+void encodeBC7(const uint8_t rgba[64], uint8_t out[16]) {
+    BlockColors block;
+    loadBlock(rgba, block);
+
+    float low[4], high[4];
+    axisEndpoints(block, 4, low, high);
+
+    int best0[4] = {}, best1[4] = {}, bestP0 = 0, bestP1 = 0;
+    uint8_t bestIndices[16] = {};
+    int bestError = 1 << 30;
+
+    for (int iteration = 0; iteration < 3; iteration++) {
+        int q0[4], q1[4], p0, p1;
+        quantizeBC7Endpoint(low, q0, p0);
+        quantizeBC7Endpoint(high, q1, p1);
+        int endpoint0[4], endpoint1[4];
+        for (int c = 0; c < 4; c++) {
+            endpoint0[c] = q0[c] * 2 + p0;
+            endpoint1[c] = q1[c] * 2 + p1;
+        }
+
+        uint8_t indices[16];
+        int error = selectBC7Indices(block, endpoint0, endpoint1, indices);
+        if (error < bestError) {
+            bestError = error;
+            memcpy(best0, q0, sizeof(q0));
+            memcpy(best1, q1, sizeof(q1));
+            bestP0 = p0;
+            bestP1 = p1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        float weights[16];
+        for (int i = 0; i < 16; i++)
+            weights[i] = kBC7Weights4[indices[i]] / 64.0f;
+        if (!refineEndpoints(block, 4, weights, low, high))
+            break;
+    }
+
+    // 第 0 个纹素（锚点）的索引最高位隐含为 0，否则交换端点并翻转索引
+    if (bestIndices[0] >= 8) {
+        std::swap(best0, best1);
+        std::swap(bestP0, bestP1);
+        for (int i = 0; i < 16; i++)
+            bestIndices[i] = (uint8_t)(15 - bestIndices[i]);
+    }
+
+    BitWriter writer(out, 16);
+    writer.write(1 << 6, 7);    // 模式 6
+    for (int c = 0; c < 4; c++) {
+        writer.write(best0[c], 7);
+        writer.write(best1[c], 7);
+    }
+    writer.write(bestP0, 1);
+    writer.write(bestP1, 1);
+    writer.write(bestIndices[0], 3);
+    for (int i = 1; i < 16; i++)
+        writer.write(bestIndices[i], 4);
+}
+
+
+std::vector<uint8_t> compressImage(const uint8_t* rgba, int width, int height, uint32_t vkFormat) {
+    Ktx2FormatInfo info;
+    ktx2FormatInfo(vkFormat, info);
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    std::vector<uint8_t> result((size_t)blocksX * blocksY * info.blockBytes);
+
+    workerPool().parallelFor(0, blocksY, 1, [&](size_t first, size_t last) {
+        uint8_t texels[64];
+        for (size_t blockY = first; blockY < last; blockY++) {
+            for (int blockX = 0; blockX < blocksX; blockX++) {
+                for (int i = 0; i < 16; i++) {
+                    int x = std::min(blockX * 4 + (i & 3), width - 1);
+                    int y = std::min((int)blockY * 4 + (i >> 2), height - 1);
+                    memcpy(&texels[i * 4], &rgba[((size_t)y * width + x) * 4], 4);
+                }
+
+                uint8_t* out = &result[((size_t)blockY * blocksX + blockX) * info.blockBytes];
+                switch (vkFormat) {
+                case KTX2_FORMAT_BC1_RGB_UNORM:
+                case KTX2_FORMAT_BC1_RGB_SRGB:
+                    encodeBC1(texels, out);
+                    break;
+                case KTX2_FORMAT_BC3_UNORM:
+                case KTX2_FORMAT_BC3_SRGB:
+                    encodeBC3(texels, out);
+                    break;
+                case KTX2_FORMAT_BC5_UNORM:
+                    encodeBC5(texels, out);
+                    break;
+                default:
+                    encodeBC7(texels, out);
+                    break;
+                }
+            }
+        }
+    });
+    return result;
+}
@@ -0,0 +1,21 @@
+﻿#ifndef _BC_ENCODER_H_
+#define _BC_ENCODER_H_
+
+#include <vector>
+#include <cstdint>
+
+// BCn（S3TC/RGTC/BPTC）块压缩编码器。输入为一个 4x4 块的 RGBA8 纹素（行优先，64 字节）
+//   BC1：RGB，8 字节/块（0.5 字节/纹素）
+//   BC3：BC1 颜色 + BC4 alpha，16 字节/块
+//   BC5：R、G 两个 BC4 通道，16 字节/块，用于法线贴图（Z 在着色器中由 XY 重建）
+//   BC7：只使用模式 6（单分区 RGBA 7777 + P 位，4 位索引），16 字节/块
+void encodeBC1(const uint8_t rgba[64], uint8_t out[8]);
+void encodeBC3(const uint8_t rgba[64], uint8_t out[16]);
+void encodeBC5(const uint8_t rgba[64], uint8_t out[16]);
+void encodeBC7(const uint8_t rgba[64], uint8_t out[16]);
+
+// 压缩整幅 RGBA8 图像（边缘不足 4 的块复制最后一行/列），块行在工作线程池中并行
+// vkFormat 为 ktx2.h 中的 BCn 格式，返回按块行排列的压缩数据
+std::vector<uint8_t> compressImage(const uint8_t* rgba, int width, int height, uint32_t vkFormat);
+
+#endif
@@ -0,0 +1,183 @@
+﻿#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "bc_encoder.h"
+#include "ktx2.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+// 离线把图片压缩为 BCn 格式的 KTX2（含完整 MIP 链）。输出默认与输入同名、扩展名为 .ktx2，
+// 渲染器加载 X.jpg 时若旁边有 X.ktx2 会直接上传压缩数据
+//
+// TexCompress [--format bc1|bc3|bc5|bc7] [--srgb] [--no-mips] [-o FILE] INPUT...
+//   bc7（默认）：颜色，4:1（相对 RGBA8）
+//   bc1：不透明颜色，8:1，质量低于 BC7
+//   bc3：带 alpha 的颜色，4:1
+//   bc5：法线贴图，只保留 XY，MIP 重新归一化
+
+static void printUsage() {
+    std::cerr << "Usage: TexCompress [--format bc1|bc3|bc5|bc7] [--srgb] [--no-mips] [-o FILE] INPUT..." << std::endl;
+}
+
+static std::string replaceExtension(const std::string& path, const std::string& extension) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + extension;
+    return path.substr(0, dot) + extension;
+}
+
+static float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value) {
+    value = std::min(1.0f, std::max(0.0f, value));
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+// 2x2 盒式滤波下采样一级 RGBA8（奇数尺寸时钳制到边缘）。sRGB 颜色在线性空间平均，
+// 法线贴图平均后重新归一化
+static std::vector<uint8_t> downsample(const std::vector<uint8_t>& source, int width, int height, bool srgb, bool normalMap) {
+    int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+    std::vector<uint8_t> result((size_t)nextWidth * nextHeight * 4);
+
+    workerPool().parallelFor(0, nextHeight, 16, [&](size_t first, size_t last) {
+        for (size_t y = first; y < last; y++) {
+            int y0 = std::min((int)y * 2, height - 1), y1 = std::min((int)y * 2 + 1, height - 1);
+            for (int x = 0; x < nextWidth; x++) {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                const uint8_t* texels[4] = {
+                    &source[((size_t)y0 * width + x0) * 4], &source[((size_t)y0 * width + x1) * 4],
+                    &source[((size_t)y1 * width + x0) * 4], &source[((size_t)y1 * width + x1) * 4],
+                };
+
+                float sum[4] = {};
+                for (int t = 0; t < 4; t++) {
+                    for (int c = 0; c < 4; c++) {
+                        float value = texels[t][c] / 255.0f;
+                        if (normalMap && c < 3)
+                            value = value * 2.0f - 1.0f;
+                        else if (srgb && c < 3)
+                            value = srgbToLinear(value);
+                        sum[c] += value * 0.25f;
+                    }
+                }
+
+                if (normalMap) {
+                    float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                    for (int c = 0; c < 3; c++)
+                        sum[c] = (length > 1e-6f ? sum[c] / length : (c == 2 ? 1.0f : 0.0f)) * 0.5f + 0.5f;
+                }
+                else if (srgb) {
+                    for (int c = 0; c < 3; c++)
+                        sum[c] = linearToSrgb(sum[c]);
+                }
+
+                uint8_t* out = &result[((size_t)y * nextWidth + x) * 4];
+                for (int c = 0; c < 4; c++)
+                    out[c] = (uint8_t)std::lround(std::min(1.0f, std::max(0.0f, sum[c])) * 255.0f);
+            }
+        }
+    });
+    return result;
+}
+
+static bool compressFile(const std::string& input, const std::string& output, uint32_t vkFormat, bool srgb, bool mipmaps) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(input.c_str(), &width, &height, &channels, 4);
+    if (!pixels) {
+        std::cerr << "Failed to load image: " << input << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> level(pixels, pixels + (size_t)width * height * 4);
+    stbi_image_free(pixels);
+
+    bool normalMap = vkFormat == KTX2_FORMAT_BC5_UNORM;
+    Ktx2Texture texture;
+    texture.vkFormat = vkFormat;
+    texture.width = width;
+    texture.height = height;
+
+    // 压缩前后的显存占用（未压缩按驱动实际使用的 RGBA8 计）
+    size_t uncompressedBytes = 0, compressedBytes = 0;
+    int levelWidth = width, levelHeight = height;
+    while (true) {
+        texture.levels.push_back(compressImage(level.data(), levelWidth, levelHeight, vkFormat));
+        uncompressedBytes += (size_t)levelWidth * levelHeight * 4;
+        compressedBytes += texture.levels.back().size();
+        if (!mipmaps || (levelWidth == 1 && levelHeight == 1))
+            break;
+        level = downsample(level, levelWidth, levelHeight, srgb, normalMap);
+        levelWidth = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+
+    if (!writeKtx2(output, texture, "TexCompress"))
+        return false;
+
+    std::cout << input << " -> " << output << ": " << width << "x" << height << ", " << texture.levels.size() << " levels, "
+              << uncompressedBytes / 1024 << " KB -> " << compressedBytes / 1024 << " KB ("
+              << (double)uncompressedBytes / compressedBytes << "x), "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string formatName = "bc7", outputFile;
+    bool srgb = false, mipmaps = true;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--format" && hasValue)
+            formatName = argv[++i];
+        else if (arg == "--srgb")
+            srgb = true;
+        else if (arg == "--no-mips")
+            mipmaps = false;
+        else if (arg == "-o" && hasValue)
+            outputFile = argv[++i];
+        else if (!arg.empty() && arg[0] == '-') {
+            printUsage();
+            return 1;
+        }
+        else
+            inputs.push_back(arg);
+    }
+
+    uint32_t vkFormat;
+    if (formatName == "bc1")
+        vkFormat = srgb ? KTX2_FORMAT_BC1_RGB_SRGB : KTX2_FORMAT_BC1_RGB_UNORM;
+    else if (formatName == "bc3")
+        vkFormat = srgb ? KTX2_FORMAT_BC3_SRGB : KTX2_FORMAT_BC3_UNORM;
+    else if (formatName == "bc5")
+        vkFormat = KTX2_FORMAT_BC5_UNORM;
+    else if (formatName == "bc7")
+        vkFormat = srgb ? KTX2_FORMAT_BC7_SRGB : KTX2_FORMAT_BC7_UNORM;
+    else {
+        std::cerr << "Unknown --format: " << formatName << std::endl;
+        return 1;
+    }
+    if (srgb && vkFormat == KTX2_FORMAT_BC5_UNORM) {
+        std::cerr << "BC5 has no sRGB variant" << std::endl;
+        return 1;
+    }
+    if (inputs.empty() || (!outputFile.empty() && inputs.size() > 1)) {
+        printUsage();
+        return 1;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < inputs.size(); i++)
+        ok = compressFile(inputs[i], outputFile.empty() ? replaceExtension(inputs[i], ".ktx2") : outputFile, vkFormat, srgb, mipmaps) && ok;
+    return ok ? 0 : 1;
+}